@@ -0,0 +1,305 @@
+#include "bench_client.h"
+
+#include <chrono>
+
+qint64 benchTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BenchClient::BenchClient(int id, Role role, const BenchConfig &config, BenchStats *stats, QObject *parent)
+    : QObject(parent), config(config), downloadHash(QCryptographicHash::Sha256)
+{
+    this->id = id;
+    this->role = role;
+    this->stats = stats;
+    this->socket = new QTcpSocket(this);
+    this->running = true;
+    this->clientName = "bench" + QString::number(id);
+    this->rosterLine = '\n' + clientName.toUtf8() + '\n';
+    this->connectStart = 0;
+    this->joined = false;
+    this->uploadName = clientName + ".bin";
+    this->uploadTotalPacket = 0;
+    this->uploadNo = 0;
+    this->downloading = false;
+    this->downloadOffset = 0;
+    this->downloadInterrupted = false;
+    this->reconnecting = false;
+
+    // Uploads send the same chunk over and over, only the bytes on the wire matter
+    this->uploadChunk = QByteArray(DATA_SIZE, 'u');
+
+    connect(socket, &QTcpSocket::connected, this, &BenchClient::connected);
+    connect(socket, &QTcpSocket::readyRead, this, &BenchClient::readData);
+    connect(socket, &QTcpSocket::bytesWritten, this, &BenchClient::sendFileData);
+}
+
+// Start connecting, the client logs in once the connection is established
+void BenchClient::connectToServer()
+{
+    connectStart = benchTimeNs();
+    socket->connectToHost(config.host, config.port);
+}
+
+bool BenchClient::isConnected() const
+{
+    return socket->state() == QAbstractSocket::ConnectedState;
+}
+
+// Send a text message carrying the time it was sent, padded to the configured size
+void BenchClient::sendTextMessage()
+{
+    QByteArray message = QByteArray::number(id) + ':' + QByteArray::number(benchTimeNs()) + ':';
+    if(message.size() < config.messageSize)
+    {
+        message.append(config.messageSize - message.size(), 'x');
+    }
+
+    Header header(MessageType::Text, message.size(), 1, 1);
+    send(Packet(header, message));
+    stats->messagesSent++;
+}
+
+// Stop counting and stop starting new transfers
+void BenchClient::stop()
+{
+    running = false;
+}
+
+// Log in and start the transfers of this client's role
+// A downloader that dropped its connection on purpose carries on with its download from where it got to
+void BenchClient::connected()
+{
+    if(!reconnecting)
+    {
+        stats->connectedClients++;
+    }
+
+    QByteArray name = (clientName + '\n').toUtf8();
+    Header header(MessageType::Connection, name.size(), 1, 1);
+    send(Packet(header, name));
+
+    if(role == Uploader)
+    {
+        startUpload();
+        sendFileData();
+    }
+
+    if(reconnecting)
+    {
+        reconnecting = false;
+        downloading = false;
+        if(running)
+        {
+            stats->downloadsResumed++;
+        }
+        requestDownload();
+    }
+}
+
+// Handle every complete frame received from the server
+void BenchClient::readData()
+{
+    QByteArrayView frame;
+
+    qint64 numBytes = frameDecoder.readFrom(socket);
+    qint64 now = benchTimeNs();
+    if(running)
+    {
+        stats->bytesReceived += numBytes;
+    }
+
+    while(frameDecoder.nextFrame(frame))
+    {
+        PacketView packet(frame);
+        if(!packet.valid)
+        {
+            continue;
+        }
+
+        switch (packet.header.type) {
+        case MessageType::Text:
+        {
+            // The fan-out latency is the time from the sender writing the message to this client reading it
+            QList<QByteArray> fields = packet.data.toByteArray().split(':');
+            if(running && fields.size() >= 2)
+            {
+                stats->messagesReceived++;
+                stats->latencies.append(now - fields[1].toLongLong());
+            }
+            break;
+        }
+        case MessageType::Connection:
+        {
+            // The client has joined once its own name shows up in the roster
+            stats->rosterPackets++;
+            if(!joined && ('\n' + packet.data.toByteArray()).contains(rosterLine))
+            {
+                joined = true;
+                stats->joinedClients++;
+                stats->joinLatencies.append(now - connectStart);
+            }
+            break;
+        }
+        case MessageType::Disconnection:
+        {
+            stats->rosterPackets++;
+            break;
+        }
+        case MessageType::FileInfo:
+        {
+            // Download the first shared file this client hears about
+            if(role == Downloader && downloadName.isEmpty())
+            {
+                downloadName = packet.header.fileName();
+                requestDownload();
+            }
+            break;
+        }
+        case MessageType::FileData:
+        {
+            // The connection has been dropped, the frames still in the decoder belong to it
+            if(!receiveFileData(packet))
+            {
+                return;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// Check a downloaded packet against its checksum and add it to the hash of the file
+// With interrupted downloads the connection is dropped halfway through the file and the download resumed from the verified offset
+// Return false once the connection has been dropped
+bool BenchClient::receiveFileData(const PacketView &packet)
+{
+    const Header &header = packet.header;
+    qint64 offset = qint64(header.no - 1) * DATA_SIZE;
+    if(offset != downloadOffset)
+    {
+        return true;
+    }
+
+    if(packet.tail.size() >= CHUNK_CHECKSUM_SIZE && qFromLittleEndian<quint32>(packet.tail.data()) != Crc32c::checksum(packet.data))
+    {
+        // Ask for the rest of the file again from the damaged packet
+        stats->downloadErrors++;
+        downloading = false;
+        requestDownload();
+        return true;
+    }
+
+    downloadHash.addData(packet.data);
+    downloadOffset += packet.data.size();
+    if(running)
+    {
+        stats->fileBytesDownloaded += packet.data.size();
+    }
+
+    // Check the whole file and download it again once it is complete
+    if(header.no == header.totalPacket)
+    {
+        // The server only sends the hash of files it has received itself
+        QByteArrayView fileHash = packet.tail.sliced(CHUNK_CHECKSUM_SIZE);
+        if(!fileHash.isEmpty() && fileHash != QByteArrayView(downloadHash.result()))
+        {
+            stats->downloadErrors++;
+        }
+        else if(running)
+        {
+            stats->downloadsVerified++;
+        }
+
+        downloadOffset = 0;
+        downloadHash.reset();
+        downloadInterrupted = false;
+        downloading = false;
+        requestDownload();
+        return true;
+    }
+
+    // Drop the connection halfway through the file, once per download
+    if(config.interruptDownloads && !downloadInterrupted && header.no == header.totalPacket / 2)
+    {
+        downloadInterrupted = true;
+        reconnecting = true;
+        socket->abort();
+        frameDecoder = FrameDecoder();
+        connectToServer();
+        return false;
+    }
+
+    return true;
+}
+
+// Send upload packets until the socket's write buffer is full, called again whenever it drains
+void BenchClient::sendFileData()
+{
+    while(uploadNo < uploadTotalPacket && socket->bytesToWrite() < BENCH_WRITE_BUFFER_LIMIT)
+    {
+        uploadNo++;
+
+        // Every packet is full except the last one
+        int dataSize = uploadNo < uploadTotalPacket ? DATA_SIZE : config.uploadSize % DATA_SIZE;
+        Header header(MessageType::FileData, uploadName, dataSize, uploadTotalPacket, uploadNo);
+        send(Packet(header, uploadChunk.left(dataSize)));
+
+        if(running)
+        {
+            stats->fileBytesUploaded += dataSize;
+        }
+
+        // Upload the file again once it is complete
+        if(uploadNo == uploadTotalPacket)
+        {
+            startUpload();
+        }
+    }
+}
+
+// Send a packet to the server
+void BenchClient::send(Packet packet)
+{
+    QByteArray frame = Frame::encode(packet, HeaderFormat::Binary);
+    socket->write(frame);
+
+    if(running)
+    {
+        stats->bytesSent += frame.size();
+    }
+}
+
+// Start uploading this client's file
+void BenchClient::startUpload()
+{
+    if(!running)
+    {
+        uploadTotalPacket = 0;
+        uploadNo = 0;
+        return;
+    }
+
+    uploadTotalPacket = config.uploadSize / DATA_SIZE + 1;
+    uploadNo = 0;
+}
+
+// Ask the server for the file this client downloads
+void BenchClient::requestDownload()
+{
+    if(!running || downloading || downloadName.isEmpty())
+    {
+        return;
+    }
+
+    // Ask for the rest of the file from the end of what has been checked
+    FileRange range;
+    range.offset = downloadOffset;
+
+    Header header(MessageType::FileInfo, downloadName, FILE_RANGE_SIZE, 1, 1);
+    send(Packet(header, range.toData()));
+    downloading = true;
+}
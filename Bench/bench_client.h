@@ -0,0 +1,124 @@
+#ifndef BENCH_CLIENT_H
+#define BENCH_CLIENT_H
+
+#include <QtCore>
+#include <QtNetwork>
+
+#include "packet.h"
+#include "frame.h"
+#include "crc32c.h"
+
+// Stop queueing upload data once this many bytes are waiting in the socket's write buffer
+#define BENCH_WRITE_BUFFER_LIMIT (256 * 1024)
+
+// Settings of a benchmark run
+struct BenchConfig
+{
+    QString host = "127.0.0.1";
+    quint16 port = 1234;
+    int numClients = 100;
+    int numThreads = 1;
+    int duration = 10;
+    double messageRate = 1.0;
+    int messageSize = 64;
+    int numUploaders = 0;
+    qint64 uploadSize = 1024 * 1024;
+    int numDownloaders = 0;
+    int connectWindow = 0;
+    bool interruptDownloads = false;
+};
+
+// Counters collected by the clients of one worker
+struct BenchStats
+{
+    int connectedClients = 0;
+    int joinedClients = 0;
+    qint64 rosterPackets = 0;
+    qint64 messagesSent = 0;
+    qint64 messagesReceived = 0;
+    qint64 bytesSent = 0;
+    qint64 bytesReceived = 0;
+    qint64 fileBytesUploaded = 0;
+    qint64 fileBytesDownloaded = 0;
+    qint64 downloadsVerified = 0;
+    qint64 downloadsResumed = 0;
+    qint64 downloadErrors = 0;
+    QList<qint64> latencies;
+    QList<qint64> joinLatencies;
+
+    void merge(const BenchStats &other)
+    {
+        connectedClients += other.connectedClients;
+        joinedClients += other.joinedClients;
+        rosterPackets += other.rosterPackets;
+        messagesSent += other.messagesSent;
+        messagesReceived += other.messagesReceived;
+        bytesSent += other.bytesSent;
+        bytesReceived += other.bytesReceived;
+        fileBytesUploaded += other.fileBytesUploaded;
+        fileBytesDownloaded += other.fileBytesDownloaded;
+        downloadsVerified += other.downloadsVerified;
+        downloadsResumed += other.downloadsResumed;
+        downloadErrors += other.downloadErrors;
+        latencies.append(other.latencies);
+        joinLatencies.append(other.joinLatencies);
+    }
+};
+
+// Monotonic time in nanoseconds, comparable across the threads of the benchmark
+qint64 benchTimeNs();
+
+// One simulated chat client
+class BenchClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Role
+    {
+        Chatter,
+        Uploader,
+        Downloader
+    };
+
+    BenchClient(int id, Role role, const BenchConfig &config, BenchStats *stats, QObject *parent = nullptr);
+    void connectToServer();
+    bool isConnected() const;
+    void sendTextMessage();
+    void stop();
+
+private slots:
+    void connected();
+    void readData();
+    void sendFileData();
+
+private:
+    void send(Packet packet);
+    void startUpload();
+    void requestDownload();
+    bool receiveFileData(const PacketView &packet);
+
+    int id;
+    Role role;
+    const BenchConfig &config;
+    BenchStats *stats;
+    QTcpSocket *socket;
+    FrameDecoder frameDecoder;
+    bool running;
+    QString clientName;
+    QByteArray rosterLine;
+    qint64 connectStart;
+    bool joined;
+    QString uploadName;
+    QByteArray uploadChunk;
+    int uploadTotalPacket;
+    int uploadNo;
+    QString downloadName;
+    bool downloading;
+    qint64 downloadOffset;
+    QCryptographicHash downloadHash;
+    bool downloadInterrupted;
+    bool reconnecting;
+};
+
+#endif // BENCH_CLIENT_H
@@ -0,0 +1,95 @@
+#include "bench_worker.h"
+
+// Interval at which the chatters send their messages
+#define TICK_INTERVAL 10
+
+BenchWorker::BenchWorker(BenchConfig config, int firstId, int numClients)
+{
+    this->config = config;
+    this->firstId = firstId;
+    this->numClients = numClients;
+    this->timer = nullptr;
+    this->lastTick = 0;
+    this->messageCredit = 0;
+}
+
+// Get the counters, called once the worker is stopped
+BenchStats BenchWorker::stats() const
+{
+    return benchStats;
+}
+
+// Create and connect the clients, called on the worker's thread
+void BenchWorker::start()
+{
+    for(int i = 0; i < numClients; i++)
+    {
+        // Every client chats, the first ones also upload and the next ones also download
+        int id = firstId + i;
+        BenchClient::Role role = BenchClient::Chatter;
+        if(id < config.numUploaders)
+        {
+            role = BenchClient::Uploader;
+        }
+        else if(id < config.numUploaders + config.numDownloaders)
+        {
+            role = BenchClient::Downloader;
+        }
+
+        BenchClient *client = new BenchClient(id, role, config, &benchStats, this);
+        clients.append(client);
+
+        // Spread the connections of all clients evenly over the connect window
+        int delay = config.connectWindow * qint64(id) / config.numClients;
+        if(delay > 0)
+        {
+            QTimer::singleShot(delay, client, &BenchClient::connectToServer);
+        }
+        else
+        {
+            client->connectToServer();
+        }
+    }
+
+    this->timer = new QTimer(this);
+    timer->setInterval(TICK_INTERVAL);
+    connect(timer, &QTimer::timeout, this, &BenchWorker::sendTextMessages);
+    lastTick = benchTimeNs();
+    timer->start();
+}
+
+// Stop sending, the clients stay connected so that in-flight messages are not counted as lost
+void BenchWorker::stop()
+{
+    if(timer)
+    {
+        timer->stop();
+    }
+
+    foreach(BenchClient *client, clients)
+    {
+        client->stop();
+    }
+}
+
+// Let every connected client send the messages it is due at the configured rate
+void BenchWorker::sendTextMessages()
+{
+    qint64 now = benchTimeNs();
+    messageCredit += config.messageRate * (now - lastTick) / 1e9;
+    lastTick = now;
+
+    int numMessages = int(messageCredit);
+    messageCredit -= numMessages;
+
+    foreach(BenchClient *client, clients)
+    {
+        if(client->isConnected())
+        {
+            for(int i = 0; i < numMessages; i++)
+            {
+                client->sendTextMessage();
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef BENCH_WORKER_H
+#define BENCH_WORKER_H
+
+#include <QtCore>
+
+#include "bench_client.h"
+
+// Event loop thread running a share of the simulated clients
+class BenchWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchWorker(BenchConfig config, int firstId, int numClients);
+    BenchStats stats() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void sendTextMessages();
+
+private:
+    BenchConfig config;
+    int firstId;
+    int numClients;
+    QList<BenchClient *> clients;
+    QTimer *timer;
+    BenchStats benchStats;
+    qint64 lastTick;
+    double messageCredit;
+};
+
+#endif // BENCH_WORKER_H
@@ -0,0 +1,48 @@
+QT = core network
+
+CONFIG += c++17 cmdline
+
+TARGET = chatbench
+
+# The benchmark speaks the same protocol as the server, so it builds against the server's headers
+# The transfer benchmarks run the server's file transfer classes themselves
+INCLUDEPATH += ../Server
+
+# The history benchmark runs the client's chat history model, it only needs QtCore like the rest of the benchmark
+INCLUDEPATH += ../Client
+
+HEADERS += \
+    ../Server/buffer_pool.h \
+    ../Server/crc32c.h \
+    ../Server/file_writer.h \
+    ../Server/frame.h \
+    ../Server/header.h \
+    ../Server/packet.h \
+    ../Server/transfer_session.h \
+    ../Client/chat_history_model.h \
+    ../Client/download_file.h \
+    bench_client.h \
+    bench_worker.h \
+    frame_fuzz.h \
+    header_bench.h \
+    history_bench.h \
+    transfer_bench.h
+
+SOURCES += \
+        ../Server/buffer_pool.cpp \
+        ../Server/file_writer.cpp \
+        ../Server/transfer_session.cpp \
+        ../Client/chat_history_model.cpp \
+        ../Client/download_file.cpp \
+        bench_client.cpp \
+        bench_worker.cpp \
+        frame_fuzz.cpp \
+        header_bench.cpp \
+        history_bench.cpp \
+        main.cpp \
+        transfer_bench.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,106 @@
+#include "frame_fuzz.h"
+
+#include "frame.h"
+
+// Seed of the generated stream, the same stream is generated on every run
+#define FRAME_FUZZ_SEED 20240611
+
+// Random bytes biased towards the bytes that can start a frame
+// Zeros are not favoured, text frames carry no checksum and a run of them in front of a start byte reads as a length prefix
+static QByteArray adversarialBytes(QRandomGenerator &random, qsizetype size)
+{
+    static const char frameBytes[] = {START_BYTE, char(FRAME_MAGIC), LEGACY_TEXT_BYTE};
+
+    QByteArray bytes(size, Qt::Uninitialized);
+    for(qsizetype i = 0; i < size; i++)
+    {
+        bytes[i] = random.bounded(4) == 0 ? frameBytes[random.bounded(3)] : char(random.bounded(256));
+    }
+    return bytes;
+}
+
+int runFrameFuzz(int numFrames, QTextStream &out)
+{
+    QRandomGenerator random(FRAME_FUZZ_SEED);
+    QByteArray stream;
+    QList<QByteArray> expected;
+    int numCorrupted = 0;
+
+    // Frames of both formats with garbage between them, some binary frames get a byte flipped
+    for(int i = 0; i < numFrames; i++)
+    {
+        stream.append(adversarialBytes(random, random.bounded(64)));
+
+        HeaderFormat format = random.bounded(4) == 0 ? HeaderFormat::Text : HeaderFormat::Binary;
+        bool fileData = random.bounded(2) == 0;
+        QByteArray data = adversarialBytes(random, fileData ? DATA_SIZE : random.bounded(1, 200));
+        Header header = fileData ? Header(MessageType::FileData, "fuzz.bin", data.size(), numFrames, i + 1)
+                                 : Header(MessageType::Text, data.size(), 1, 1);
+        QByteArray frame = Frame::encode(header, data, format);
+
+        if(format == HeaderFormat::Binary && random.bounded(20) == 0)
+        {
+            qsizetype index = FRAME_HEADER_SIZE + random.bounded(frame.size() - FRAME_HEADER_SIZE);
+            frame[index] = char(frame[index] ^ (1 << random.bounded(8)));
+            numCorrupted++;
+        }
+        else
+        {
+            expected.append(frame.sliced(format == HeaderFormat::Binary ? FRAME_HEADER_SIZE : LEGACY_PREFIX_SIZE));
+        }
+        stream.append(frame);
+    }
+
+    // Cut the stream into fragments as a socket would hand them over
+    QList<QByteArray> fragments;
+    for(qsizetype offset = 0; offset < stream.size();)
+    {
+        qsizetype size = qMin<qsizetype>(random.bounded(1, 4096), stream.size() - offset);
+        fragments.append(stream.sliced(offset, size));
+        offset += size;
+    }
+
+    // Match every decoded frame against the next intact one, later matches mean frames were lost
+    FrameDecoder decoder;
+    QByteArrayView payload;
+    qsizetype next = 0;
+    int numDelivered = 0;
+    int numLost = 0;
+    int numFalse = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    foreach(const QByteArray &fragment, fragments)
+    {
+        decoder.append(fragment);
+        while(decoder.nextFrame(payload))
+        {
+            qsizetype match = next;
+            while(match < expected.size() && payload != QByteArrayView(expected[match]))
+            {
+                match++;
+            }
+
+            if(match == expected.size())
+            {
+                numFalse++;
+                continue;
+            }
+
+            numLost += match - next;
+            numDelivered++;
+            next = match + 1;
+        }
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    numLost += expected.size() - next;
+
+    out << "stream size:         " << stream.size() << " bytes in " << fragments.size() << " fragments\n";
+    out << "intact frames:       " << numDelivered << " / " << expected.size() << " delivered, " << numLost << " lost\n";
+    out << "corrupted frames:    " << numCorrupted << " rejected\n";
+    out << "false frames:        " << numFalse << "\n";
+    out << "bytes skipped:       " << decoder.dropped() << "\n";
+    out << "decode speed:        " << stream.size() / (elapsed / 1e9) / 1e6 << " MB/s\n";
+
+    return numLost + numFalse;
+}
@@ -0,0 +1,11 @@
+#ifndef FRAME_FUZZ_H
+#define FRAME_FUZZ_H
+
+#include <QtCore>
+
+// Feed the frame decoder a stream of valid, corrupted and garbage bytes cut into random fragments
+// Print how many frames came out intact, how many corrupted frames were rejected and the decoding speed
+// Return the number of intact frames that were lost or came out wrong
+int runFrameFuzz(int numFrames, QTextStream &out);
+
+#endif // FRAME_FUZZ_H
@@ -0,0 +1,84 @@
+#include "header_bench.h"
+
+#include "header.h"
+#include "frame.h"
+
+// Keeps the compiler from dropping the work being timed
+static volatile int sink;
+
+// Time an operation run over and over and print its cost
+template<typename Operation>
+static void timeOperation(const char *name, int iterations, QTextStream &out, Operation operation)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < iterations; i++)
+    {
+        sink = sink + operation(i);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+
+    out << qSetFieldWidth(22) << Qt::left << name << qSetFieldWidth(0) << double(elapsed) / iterations << " ns/op\n";
+}
+
+// Print the size of the frames carrying a packet in the binary and the text format
+static void compareWireSize(const char *name, const Header &header, const QByteArray &data, int numPackets, QTextStream &out)
+{
+    qint64 binarySize = Frame::encode(header, data, HeaderFormat::Binary).size() * qint64(numPackets);
+    qint64 textSize = Frame::encode(header, data, HeaderFormat::Text).size() * qint64(numPackets);
+
+    out << qSetFieldWidth(22) << Qt::left << name << qSetFieldWidth(10) << Qt::right << binarySize << textSize
+        << qSetFieldWidth(0) << Qt::left << "  " << 100.0 * (textSize - binarySize) / textSize << "% saved\n";
+}
+
+void runHeaderBench(int iterations, QTextStream &out)
+{
+    QString fileName = "holiday-photos.zip";
+    Header fileHeader(MessageType::FileData, fileName, 1024, 4096, 1);
+    QByteArray binaryHeader = fileHeader.toByteArray(HeaderFormat::Binary);
+    QByteArray textHeader = fileHeader.toByteArray(HeaderFormat::Text);
+
+    timeOperation("construct", iterations, out, [](int i) {
+        Header header(MessageType::Text, i, 1, 1);
+        return header.dataSize;
+    });
+    timeOperation("construct with name", iterations, out, [&fileName](int i) {
+        Header header(MessageType::FileData, fileName, 1024, 4096, i);
+        return header.no + header.nameLength;
+    });
+    timeOperation("copy", iterations, out, [&fileHeader](int i) {
+        fileHeader.no = i;
+        Header header = fileHeader;
+        return header.no;
+    });
+    timeOperation("encode binary", iterations, out, [&fileHeader](int i) {
+        char buffer[HEADER_SIZE];
+        fileHeader.no = i;
+        return fileHeader.encode(buffer);
+    });
+    timeOperation("parse binary", iterations, out, [&binaryHeader](int) {
+        Header header;
+        return header.decode(binaryHeader.constData(), binaryHeader.size());
+    });
+    timeOperation("parse text", iterations, out, [&textHeader](int) {
+        Header header(textHeader);
+        return header.totalPacket;
+    });
+    timeOperation("type name", iterations, out, [](int i) {
+        return int(messageTypeName(MessageType(i % MessageTypeCount)).size());
+    });
+
+    // Bytes written to the socket for typical packets, frame header included
+    out << "\n" << qSetFieldWidth(22) << Qt::left << "bytes on wire" << qSetFieldWidth(10) << Qt::right << "binary" << "text"
+        << qSetFieldWidth(0) << Qt::left << "\n";
+
+    QByteArray message(40, 'm');
+    compareWireSize("text message", Header(MessageType::Text, message.size(), 1, 1), message, 1, out);
+
+    QByteArray name = "bench42\n";
+    compareWireSize("login", Header(MessageType::Connection, name.size(), 1, 1), name, 1, out);
+
+    QByteArray chunk(DATA_SIZE, 'f');
+    compareWireSize("file chunk", Header(MessageType::FileData, fileName, chunk.size(), 1024, 1), chunk, 1, out);
+    compareWireSize("1 MB file", Header(MessageType::FileData, fileName, chunk.size(), 1024, 1), chunk, 1024, out);
+}
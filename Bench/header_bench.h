@@ -0,0 +1,10 @@
+#ifndef HEADER_BENCH_H
+#define HEADER_BENCH_H
+
+#include <QtCore>
+
+// Time constructing, copying, encoding and parsing packet headers without a server
+// Print the nanoseconds per operation of each step and the bytes on the wire of each header format
+void runHeaderBench(int iterations, QTextStream &out);
+
+#endif // HEADER_BENCH_H
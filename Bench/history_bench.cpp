@@ -0,0 +1,50 @@
+#include "history_bench.h"
+
+#include "chat_history_model.h"
+
+// Messages appended at once, about what the chat window gets in one frame of a busy chat
+#define HISTORY_BENCH_BATCH_SIZE 64
+
+void runHistoryBench(int numMessages, QTextStream &out)
+{
+    ChatHistoryModel model;
+
+    QList<QPair<MessageType, QString>> batch;
+    for(int i = 0; i < HISTORY_BENCH_BATCH_SIZE; i++)
+    {
+        batch.append(qMakePair(MessageType::Text, QString("client%1: a chat message of about sixty four characters").arg(i)));
+    }
+
+    // The latency is reported for every tenfold growth of the history, it should stay flat once messages go to disk
+    out << "messages in history    mean append    worst append\n";
+    QElapsedTimer timer;
+    qint64 total = 0;
+    qint64 worst = 0;
+    int numBatches = 0;
+    int nextReport = 1000;
+    for(int added = 0; added < numMessages; added += HISTORY_BENCH_BATCH_SIZE)
+    {
+        timer.start();
+        model.addMessages(batch);
+        qint64 elapsed = timer.nsecsElapsed();
+
+        total += elapsed;
+        worst = qMax(worst, elapsed);
+        numBatches++;
+
+        int rows = model.rowCount();
+        if(rows >= nextReport || added + HISTORY_BENCH_BATCH_SIZE >= numMessages)
+        {
+            out << qSetFieldWidth(23) << Qt::left << rows << qSetFieldWidth(0)
+                << qSetFieldWidth(15) << QString::number(total / numBatches / 1e3, 'f', 1) + " us"
+                << qSetFieldWidth(0) << QString::number(worst / 1e3, 'f', 1) << " us\n";
+            total = 0;
+            worst = 0;
+            numBatches = 0;
+            while(nextReport <= rows)
+            {
+                nextReport *= 10;
+            }
+        }
+    }
+}
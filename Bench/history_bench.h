@@ -0,0 +1,10 @@
+#ifndef HISTORY_BENCH_H
+#define HISTORY_BENCH_H
+
+#include <QtCore>
+
+// Append numMessages chat messages to the client's history model in batches like the chat window gets them
+// Print the mean and worst latency of an append as the history grows, without a server or a window
+void runHistoryBench(int numMessages, QTextStream &out);
+
+#endif // HISTORY_BENCH_H
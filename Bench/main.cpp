@@ -0,0 +1,202 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <algorithm>
+
+#include "bench_worker.h"
+#include "header_bench.h"
+#include "frame_fuzz.h"
+#include "history_bench.h"
+#include "transfer_bench.h"
+
+// Time given to messages still in flight once the clients stop sending
+#define DRAIN_TIME 1000
+
+// Latency at quantile q of the sorted latencies, in milliseconds
+static double percentile(const QList<qint64> &latencies, double q)
+{
+    if(latencies.isEmpty())
+    {
+        return 0;
+    }
+
+    qsizetype index = qMin(qsizetype(q * latencies.size()), latencies.size() - 1);
+    return latencies[index] / 1e6;
+}
+
+// Print the results of the run
+static void printReport(const BenchConfig &config, BenchStats stats)
+{
+    std::sort(stats.latencies.begin(), stats.latencies.end());
+    std::sort(stats.joinLatencies.begin(), stats.joinLatencies.end());
+
+    double seconds = config.duration;
+    QTextStream out(stdout);
+    out << "clients connected:   " << stats.connectedClients << " / " << config.numClients << "\n";
+    out << "clients joined:      " << stats.joinedClients << " / " << config.numClients << "\n";
+    out << "join latency p50:    " << percentile(stats.joinLatencies, 0.5) << " ms\n";
+    out << "join latency p99:    " << percentile(stats.joinLatencies, 0.99) << " ms\n";
+    out << "join latency p999:   " << percentile(stats.joinLatencies, 0.999) << " ms\n";
+    out << "roster packets:      " << stats.rosterPackets << "\n";
+    out << "messages sent:       " << stats.messagesSent << " (" << stats.messagesSent / seconds << " msg/s)\n";
+    out << "messages delivered:  " << stats.messagesReceived << " (" << stats.messagesReceived / seconds << " msg/s)\n";
+    out << "traffic sent:        " << stats.bytesSent / seconds / 1e6 << " MB/s\n";
+    out << "traffic received:    " << stats.bytesReceived / seconds / 1e6 << " MB/s\n";
+    out << "file data uploaded:  " << stats.fileBytesUploaded / seconds / 1e6 << " MB/s\n";
+    out << "file data received:  " << stats.fileBytesDownloaded / seconds / 1e6 << " MB/s\n";
+    out << "downloads verified:  " << stats.downloadsVerified << " (" << stats.downloadsResumed << " resumed, "
+        << stats.downloadErrors << " failed checks)\n";
+    out << "fan-out latency p50: " << percentile(stats.latencies, 0.5) << " ms\n";
+    out << "fan-out latency p99: " << percentile(stats.latencies, 0.99) << " ms\n";
+    out << "fan-out latency p999: " << percentile(stats.latencies, 0.999) << " ms\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    // Parse the command line options
+    BenchConfig config;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator for the chat server, it simulates clients speaking the chat protocol.");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Address of the server.", "address", config.host);
+    QCommandLineOption portOption("port", "Port of the server.", "port", QString::number(config.port));
+    QCommandLineOption clientsOption({"c", "clients"}, "Number of simulated clients.", "count", QString::number(config.numClients));
+    QCommandLineOption threadsOption({"t", "threads"}, "Number of threads running the clients.", "count", QString::number(config.numThreads));
+    QCommandLineOption durationOption({"d", "duration"}, "Length of the run in seconds.", "seconds", QString::number(config.duration));
+    QCommandLineOption rateOption({"r", "rate"}, "Text messages sent per second by each client.", "rate", QString::number(config.messageRate));
+    QCommandLineOption sizeOption({"s", "size"}, "Size of a text message in bytes.", "bytes", QString::number(config.messageSize));
+    QCommandLineOption uploadersOption("uploaders", "Number of clients uploading a file over and over.", "count", QString::number(config.numUploaders));
+    QCommandLineOption uploadSizeOption("upload-size", "Size of the uploaded file in bytes.", "bytes", QString::number(config.uploadSize));
+    QCommandLineOption downloadersOption("downloaders", "Number of clients downloading a shared file over and over.", "count", QString::number(config.numDownloaders));
+    QCommandLineOption connectWindowOption("connect-window", "Spread the connections of the clients over this many milliseconds, 0 connects them all at once.",
+                                           "ms", QString::number(config.connectWindow));
+    QCommandLineOption interruptOption("interrupt-downloads", "Drop the connection of every downloader halfway through each download, "
+                                       "it reconnects and resumes from the last verified offset.");
+    QCommandLineOption headerBenchOption("header-bench", "Only time packet header construction, copies and parsing, this many times each.",
+                                         "iterations");
+    QCommandLineOption frameFuzzOption("frame-fuzz", "Only feed the frame decoder this many frames mixed with garbage and corrupted frames, "
+                                       "cut into random fragments.", "frames");
+    QCommandLineOption transferMemoryOption("transfer-memory", "Only stream a sparse file of this many bytes through the server's "
+                                            "file transfer and check that its memory stays within the read window.", "bytes");
+    QCommandLineOption uploadBenchOption("upload-bench", "Only write this many bytes of upload packets to disk, the old way "
+                                         "and through the server's file writer.", "bytes");
+    QCommandLineOption bufferPoolOption("buffer-pool-check", "Only run this many file transfers at once from a buffer pool too small "
+                                        "for them and check that its counters add up once they end.", "transfers");
+    QCommandLineOption downloadFallbackOption("download-fallback", "Only download this many bytes into a file whose space "
+                                              "cannot be reserved and check that it completes without extra connections.", "bytes");
+    QCommandLineOption historyBenchOption("history-bench", "Only append this many messages to the client's chat history model "
+                                          "and time the appends as the history grows.", "messages");
+    parser.addOptions({hostOption, portOption, clientsOption, threadsOption, durationOption, rateOption, sizeOption,
+                       uploadersOption, uploadSizeOption, downloadersOption, connectWindowOption, interruptOption, headerBenchOption,
+                       frameFuzzOption, transferMemoryOption, uploadBenchOption, bufferPoolOption, downloadFallbackOption, historyBenchOption});
+    parser.process(a);
+
+    // The header microbenchmark runs on its own, without a server
+    if(parser.isSet(headerBenchOption))
+    {
+        QTextStream out(stdout);
+        runHeaderBench(qMax(parser.value(headerBenchOption).toInt(), 1), out);
+        return 0;
+    }
+
+    // So does the frame decoder fuzzer, it fails when an intact frame is lost or a false one comes out
+    if(parser.isSet(frameFuzzOption))
+    {
+        QTextStream out(stdout);
+        return runFrameFuzz(qMax(parser.value(frameFuzzOption).toInt(), 1), out) == 0 ? 0 : 1;
+    }
+
+    // The file transfer checks do not need a server either
+    if(parser.isSet(transferMemoryOption))
+    {
+        QTextStream out(stdout);
+        return runTransferMemoryBench(qMax(parser.value(transferMemoryOption).toLongLong(), qint64(0)), out) ? 0 : 1;
+    }
+    if(parser.isSet(uploadBenchOption))
+    {
+        QTextStream out(stdout);
+        return runUploadBench(qMax(parser.value(uploadBenchOption).toLongLong(), qint64(0)), out) ? 0 : 1;
+    }
+    if(parser.isSet(bufferPoolOption))
+    {
+        QTextStream out(stdout);
+        return runBufferPoolCheck(qMax(parser.value(bufferPoolOption).toInt(), 1), out) ? 0 : 1;
+    }
+    if(parser.isSet(downloadFallbackOption))
+    {
+        QTextStream out(stdout);
+        return runDownloadFallbackCheck(qMax(parser.value(downloadFallbackOption).toLongLong(), qint64(0)), out) ? 0 : 1;
+    }
+
+    // The chat history model is timed on its own as well, without a window
+    if(parser.isSet(historyBenchOption))
+    {
+        QTextStream out(stdout);
+        runHistoryBench(qMax(parser.value(historyBenchOption).toInt(), 1), out);
+        return 0;
+    }
+
+    config.host = parser.value(hostOption);
+    config.port = parser.value(portOption).toUShort();
+    config.numClients = qMax(parser.value(clientsOption).toInt(), 1);
+    config.numThreads = qBound(1, parser.value(threadsOption).toInt(), config.numClients);
+    config.duration = qMax(parser.value(durationOption).toInt(), 1);
+    config.messageRate = qMax(parser.value(rateOption).toDouble(), 0.0);
+    config.messageSize = qMax(parser.value(sizeOption).toInt(), 1);
+    config.numUploaders = qMax(parser.value(uploadersOption).toInt(), 0);
+    config.uploadSize = qMax(parser.value(uploadSizeOption).toLongLong(), qint64(0));
+    config.numDownloaders = qMax(parser.value(downloadersOption).toInt(), 0);
+    config.connectWindow = qMax(parser.value(connectWindowOption).toInt(), 0);
+    config.interruptDownloads = parser.isSet(interruptOption);
+
+    // Spread the clients over the threads
+    QList<QThread *> threads;
+    QList<BenchWorker *> workers;
+    for(int i = 0; i < config.numThreads; i++)
+    {
+        int firstId = config.numClients * i / config.numThreads;
+        int lastId = config.numClients * (i + 1) / config.numThreads;
+
+        QThread *thread = new QThread(&a);
+        BenchWorker *worker = new BenchWorker(config, firstId, lastId - firstId);
+        worker->moveToThread(thread);
+        QObject::connect(thread, &QThread::started, worker, &BenchWorker::start);
+        QObject::connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+
+        threads.append(thread);
+        workers.append(worker);
+    }
+
+    // Stop the clients once the run is over, then collect the counters after in-flight messages arrived
+    QTimer::singleShot(config.duration * 1000, &a, [&]() {
+        foreach(BenchWorker *worker, workers)
+        {
+            QMetaObject::invokeMethod(worker, &BenchWorker::stop, Qt::QueuedConnection);
+        }
+
+        QTimer::singleShot(DRAIN_TIME, &a, [&]() {
+            BenchStats stats;
+            foreach(BenchWorker *worker, workers)
+            {
+                BenchStats workerStats;
+                QMetaObject::invokeMethod(worker, [worker, &workerStats]() {
+                    workerStats = worker->stats();
+                }, Qt::BlockingQueuedConnection);
+                stats.merge(workerStats);
+            }
+
+            printReport(config, stats);
+
+            foreach(QThread *thread, threads)
+            {
+                thread->quit();
+                thread->wait();
+            }
+            a.quit();
+        });
+    });
+
+    return a.exec();
+}
@@ -0,0 +1,245 @@
+#include "transfer_bench.h"
+
+#include "frame.h"
+#include "transfer_session.h"
+#include "file_writer.h"
+#include "buffer_pool.h"
+#include "crc32c.h"
+#include "download_file.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <csignal>
+#endif
+
+// Memory a transfer may add on top of its read window: the frame buffer, the pool's bookkeeping and the allocator's slack
+#define TRANSFER_MEMORY_SLACK (8 * 1024 * 1024)
+
+// Peak resident memory of the process in bytes, -1 where it cannot be read
+static qint64 peakMemory()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss;
+#else
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return -1;
+}
+
+// Print the speed of writing numBytes in elapsed nanoseconds
+static void printSpeed(const char *name, qint64 numBytes, qint64 elapsed, QTextStream &out)
+{
+    out << qSetFieldWidth(21) << Qt::left << name << qSetFieldWidth(0) << numBytes / (elapsed / 1e9) / 1e6 << " MB/s\n";
+}
+
+bool runTransferMemoryBench(qint64 fileSize, QTextStream &out)
+{
+    // A sparse file takes no disk space, so it can be larger than the memory of the machine
+    QTemporaryFile file;
+    if(!file.open() || !file.resize(fileSize))
+    {
+        out << "Could not create a file of " << fileSize << " bytes\n";
+        return false;
+    }
+    file.close();
+
+    BufferPool pool(DEFAULT_BUFFER_POOL_BUDGET);
+    qint64 peakBefore = peakMemory();
+
+    // Read and frame every packet the way the server sends a download
+    QElapsedTimer timer;
+    timer.start();
+    TransferSession session(file.fileName(), "transfer.bin", DEFAULT_READ_WINDOW_SIZE, &pool);
+    QByteArray frame;
+    qint64 numBytes = 0;
+    while(!session.atEnd())
+    {
+        Header header;
+        QByteArrayView tail;
+        QByteArrayView chunk = session.nextChunk(&header, &tail);
+        Frame::encodeInto(frame, header, chunk, HeaderFormat::Binary, tail);
+        numBytes += chunk.size();
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+
+    qint64 peakAfter = peakMemory();
+    qint64 growth = peakAfter - peakBefore;
+    qint64 limit = DEFAULT_READ_WINDOW_SIZE + TRANSFER_MEMORY_SLACK;
+
+    out << "file size:           " << fileSize << " bytes, " << numBytes << " sent\n";
+    out << "read speed:          " << numBytes / (elapsed / 1e9) / 1e6 << " MB/s\n";
+    if(peakBefore < 0)
+    {
+        out << "peak memory growth:  not available on this platform\n";
+        return numBytes == fileSize;
+    }
+
+    out << "peak memory growth:  " << growth << " bytes (limit " << limit << ")\n";
+    return numBytes == fileSize && growth <= limit;
+}
+
+bool runBufferPoolCheck(int numTransfers, QTextStream &out)
+{
+    QTemporaryFile file;
+    if(!file.open() || !file.resize(4 * DEFAULT_READ_WINDOW_SIZE))
+    {
+        out << "Could not create a file to transfer\n";
+        return false;
+    }
+    file.close();
+
+    // Transfers after the first two find the budget used up and read the file one packet at a time
+    BufferPool pool(2 * DEFAULT_READ_WINDOW_SIZE);
+    QList<TransferSession *> sessions;
+    for(int i = 0; i < numTransfers; i++)
+    {
+        sessions.append(new TransferSession(file.fileName(), "pool.bin", DEFAULT_READ_WINDOW_SIZE, &pool));
+    }
+    qint64 peakUsedBytes = pool.usedBytes();
+
+    // Send every transfer a packet at a time in turn, like a connection with several downloads
+    qint64 numBytes = 0;
+    bool sending = true;
+    while(sending)
+    {
+        sending = false;
+        foreach(TransferSession *session, sessions)
+        {
+            if(!session->atEnd())
+            {
+                Header header;
+                QByteArrayView tail;
+                numBytes += session->nextChunk(&header, &tail).size();
+                sending = true;
+            }
+        }
+    }
+    qDeleteAll(sessions);
+
+    out << "transfers:           " << numTransfers << ", " << numBytes << " bytes sent\n";
+    out << "pool budget:         " << pool.budget() << " bytes\n";
+    out << "used while sending:  " << peakUsedBytes << " bytes\n";
+    out << "used after:          " << pool.usedBytes() << " bytes\n";
+    out << "kept for reuse:      " << pool.freeBytes() << " bytes\n";
+    return peakUsedBytes <= pool.budget() && pool.usedBytes() == 0 && pool.freeBytes() <= pool.budget();
+}
+
+bool runUploadBench(qint64 fileSize, QTextStream &out)
+{
+    QTemporaryDir dir;
+    if(!dir.isValid())
+    {
+        out << "Could not create a directory for the uploads\n";
+        return false;
+    }
+
+    QByteArray chunk(DATA_SIZE, 'u');
+    qint64 numPackets = (fileSize + DATA_SIZE - 1) / DATA_SIZE;
+    QElapsedTimer timer;
+
+    // Before: the file is opened for every packet and written a byte at a time
+    timer.start();
+    QFile legacyFile(dir.filePath("legacy.bin"));
+    for(qint64 i = 0; i < numPackets; i++)
+    {
+        if(!legacyFile.open(QIODevice::Append))
+        {
+            out << "Could not open " << legacyFile.fileName() << "\n";
+            return false;
+        }
+        for(char byte : chunk)
+        {
+            legacyFile.putChar(byte);
+        }
+        legacyFile.close();
+    }
+    printSpeed("open/putChar/close:", numPackets * DATA_SIZE, timer.nsecsElapsed(), out);
+
+    // After: one writer keeps the file open and writes whole buffers
+    BufferPool pool(DEFAULT_BUFFER_POOL_BUDGET);
+    timer.restart();
+    FileWriter writer(dir.filePath("writer.bin"), DEFAULT_FILE_BUFFER_SIZE, 0, &pool);
+    bool written = writer.open();
+    for(qint64 i = 0; written && i < numPackets; i++)
+    {
+        written = writer.write(chunk.constData(), chunk.size());
+    }
+    written = written && writer.commit();
+    printSpeed("FileWriter:", numPackets * DATA_SIZE, timer.nsecsElapsed(), out);
+
+    return written;
+}
+
+bool runDownloadFallbackCheck(qint64 fileSize, QTextStream &out)
+{
+#ifdef Q_OS_UNIX
+    QTemporaryDir dir;
+    if(!dir.isValid())
+    {
+        out << "Could not create a directory for the download\n";
+        return false;
+    }
+
+    // The file size limit of the process lets the file be written but not its space be reserved twice over
+    qint64 numPackets = fileSize / DATA_SIZE + 1;
+    struct rlimit oldLimit;
+    getrlimit(RLIMIT_FSIZE, &oldLimit);
+    struct rlimit limit = oldLimit;
+    limit.rlim_cur = rlim_t(numPackets * DATA_SIZE);
+    void (*oldHandler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    BufferPool pool(DEFAULT_BUFFER_POOL_BUDGET);
+    DownloadFile download(dir.filePath("download.bin"), DEFAULT_READ_WINDOW_SIZE, &pool);
+    bool opened = download.open();
+    bool reserved = opened && download.preallocate(2 * numPackets * DATA_SIZE);
+
+    // The packets then come from the start of the file, one range over the main connection
+    QRandomGenerator random(quint32(numPackets));
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    int numWritten = 0;
+    int numSkipped = 0;
+    for(qint64 i = 0; opened && !reserved && i < numPackets; i++)
+    {
+        QByteArray data(i + 1 < numPackets ? DATA_SIZE : fileSize % DATA_SIZE, Qt::Uninitialized);
+        for(char &byte : data)
+        {
+            byte = char(random.bounded(256));
+        }
+        hash.addData(data);
+
+        QByteArray tail(CHUNK_CHECKSUM_SIZE, Qt::Uninitialized);
+        qToLittleEndian<quint32>(Crc32c::checksum(data), tail.data());
+
+        DownloadFile::WriteResult result = download.write(i * DATA_SIZE, data, tail);
+        if(result == DownloadFile::WriteResult::Written)
+        {
+            numWritten++;
+        }
+        else if(result == DownloadFile::WriteResult::Skipped)
+        {
+            numSkipped++;
+        }
+    }
+    download.setFileEnd(fileSize, hash.result());
+    bool finished = opened && !reserved && numWritten == numPackets && download.finish();
+
+    setrlimit(RLIMIT_FSIZE, &oldLimit);
+    std::signal(SIGXFSZ, oldHandler);
+
+    out << "space reserved:      " << (reserved ? "yes, the failure could not be set up" : "no") << "\n";
+    out << "packets written:     " << numWritten << " / " << numPackets << " (" << numSkipped << " skipped)\n";
+    out << "download finished:   " << (finished ? "yes" : "no") << "\n";
+    return finished && QFileInfo(dir.filePath("download.bin")).size() == fileSize;
+#else
+    Q_UNUSED(fileSize);
+    out << "download fallback:   not available on this platform\n";
+    return true;
+#endif
+}
@@ -0,0 +1,22 @@
+#ifndef TRANSFER_BENCH_H
+#define TRANSFER_BENCH_H
+
+#include <QtCore>
+
+// Stream a sparse file of fileSize bytes through the server's transfer session and frame encoder without a server
+// Print the speed and how much the peak memory of the process grew, return false if it grew beyond the read window
+bool runTransferMemoryBench(qint64 fileSize, QTextStream &out);
+
+// Run numTransfers transfers of one file at once from a pool with room for only two read windows
+// Print the pool's counters, return false if they do not go back to no bytes handed out once the transfers end
+bool runBufferPoolCheck(int numTransfers, QTextStream &out);
+
+// Receive fileSize bytes of upload packets into a file, once the way the server used to and once through its file writer
+// Print the MB/s of both, return false if a file could not be written
+bool runUploadBench(qint64 fileSize, QTextStream &out);
+
+// Download fileSize bytes into the client's download file after reserving its space failed, as on a full disk
+// Print what happened, return false if the download did not complete through the sequential fallback
+bool runDownloadFallbackCheck(qint64 fileSize, QTextStream &out);
+
+#endif // TRANSFER_BENCH_H
@@ -9,17 +9,33 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    buffer_pool.cpp \
     chatUI.cpp \
+    chat_history_model.cpp \
+    chat_message_delegate.cpp \
+    client_list_model.cpp \
+    download_file.cpp \
+    download_stream.cpp \
     loginUI.cpp \
     main.cpp \
-    tcp_manager_thread.cpp
+    tcp_manager.cpp \
+    transfer_session.cpp
 
 HEADERS += \
+    buffer_pool.h \
     chatUI.h \
+    chat_history_model.h \
+    chat_message_delegate.h \
+    client_list_model.h \
+    crc32c.h \
+    download_file.h \
+    download_stream.h \
+    frame.h \
     header.h \
     loginUI.h \
     packet.h \
-    tcp_manager_thread.h
+    tcp_manager.h \
+    transfer_session.h
 
 FORMS += \
     chatUI.ui \
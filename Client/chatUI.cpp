@@ -6,9 +6,11 @@ Chat::Chat(QWidget *parent)
     , ui(new Ui::Chat)
 {
     ui->setupUi(this);
+    this->networkThread = nullptr;
+    this->tcpManager = nullptr;
 }
 
-Chat::Chat(QTcpSocket *socket, QString clientName, QWidget *parent)
+Chat::Chat(QTcpSocket *socket, QString clientName, int downloadStreams, QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::Chat)
 {
@@ -16,19 +18,24 @@ Chat::Chat(QTcpSocket *socket, QString clientName, QWidget *parent)
     this->setWindowTitle("Chat Application");
     this->clientName = clientName;
 
-    // Create a new thread to manage the TCP connection
-    this->tcpManager = new TCPManagerThread(socket);
+    // Move the TCP connection onto its own thread, so that socket I/O and file reads never block the UI
+    this->networkThread = new QThread(this);
+    this->tcpManager = new TCPManager(socket, downloadStreams);
+    tcpManager->moveToThread(networkThread);
+    connect(networkThread, &QThread::finished, tcpManager, &QObject::deleteLater);
 
-    // Connect the signals from the TCPManagerThread to the functions in this class
-    connect(tcpManager, &TCPManagerThread::newMessageReceived, this, &Chat::addDialogToUI);
-    connect(tcpManager, &TCPManagerThread::newClientConnected, this, &Chat::addNewClientToUI);
-    connect(tcpManager, &TCPManagerThread::clientDisconnected, this, &Chat::deleteClientFromUI);
-    connect(tcpManager, &TCPManagerThread::newFileReceived, this, &Chat::addNewSharedFileToUI);
-    connect(tcpManager, &TCPManagerThread::fileProgress, this, &Chat::updateLoadingBar);
-    connect(tcpManager, &TCPManagerThread::connectionError, this, &Chat::displayError);
+    // Connect the signals from the TCPManager to the functions in this class
+    connect(tcpManager, &TCPManager::eventsReceived, this, &Chat::handleEvents);
+    connect(tcpManager, &TCPManager::connectionStateChanged, this, &Chat::updateConnectionState);
 
-    // Start the TCP manager thread
-    this->tcpManager->start();
+    // Connect the requests of this class to the TCPManager, they run on the network thread
+    connect(this, &Chat::sendMessageRequested, tcpManager, &TCPManager::sendMessage);
+    connect(this, &Chat::uploadRequested, tcpManager, &TCPManager::readFiles);
+    connect(this, &Chat::downloadRequested, tcpManager, &TCPManager::requestFile);
+    connect(this, &Chat::rosterPageRequested, tcpManager, &TCPManager::requestRosterPage);
+
+    // Start the network thread
+    networkThread->start();
 
     // Create a timer to reset the loading bar
     this->loadingBarResetTimer = new QTimer(this);
@@ -40,72 +47,84 @@ Chat::Chat(QTcpSocket *socket, QString clientName, QWidget *parent)
     connect(ui->attachedFileList, &QListWidget::itemDoubleClicked, this, &Chat::removeAttachFile);
     connect(ui->sharedFileList, &QListWidget::itemDoubleClicked, this, &Chat::downloadFile);
 
+    // Show the chat dialog through a model keeping only the newest messages in memory
+    chatHistoryModel = new ChatHistoryModel(CHAT_HISTORY_MEMORY_LIMIT, this);
+    ui->chatDialogList->setModel(chatHistoryModel);
+    ui->chatDialogList->setItemDelegate(new ChatMessageDelegate(this));
+
     // Create a new client list model and set it to the client list widget
-    clientListModel = new QStandardItemModel();
+    clientListModel = new ClientListModel(this);
     ui->clientList->setModel(clientListModel);
 
+    // Fetch more of the roster when the client list is scrolled near its end
+    connect(ui->clientList->verticalScrollBar(), &QScrollBar::valueChanged, this, &Chat::fetchMoreClients);
+    connect(ui->clientList->verticalScrollBar(), &QScrollBar::rangeChanged, this, &Chat::fetchMoreClients);
+    connect(clientListModel, &ClientListModel::changesApplied, this, &Chat::fetchMoreClients);
+
     // Send a connection message to the server
-    this->tcpManager->sendMessage(MessageType::Connection, (clientName + '\n').toUtf8());
+    emit sendMessageRequested(MessageType::Connection, (clientName + '\n').toUtf8());
 }
 
 Chat::~Chat()
 {
-    tcpManager->quit();
-    delete tcpManager;
+    // Stop the network thread, the TCP manager is deleted as it finishes
+    if(networkThread)
+    {
+        networkThread->quit();
+        networkThread->wait();
+    }
     delete ui;
 }
 
-// Add a dialog line to the chat dialog text widget
-void Chat::addDialogToUI(MessageType type, QString message)
+// Apply a batch of events received from the server, the widgets are updated once per batch
+void Chat::handleEvents(ChatEvents events)
 {
-    switch (type)
+    addDialogsToUI(events.messages);
+
+    // The roster is sent again after a reconnect, the clients already listed are dropped first
+    if(events.rosterReset)
     {
-        case MessageType::Connection:
-        {
-            ui->chatDialogText->setTextColor(Qt::gray);
-            break;
-        }
-        case MessageType::Disconnection:
-        {
-            ui->chatDialogText->setTextColor(Qt::gray);
-            break;
-        }
-        case MessageType::FileInfo:
-        {
-            ui->chatDialogText->setTextColor(Qt::cyan);
-            break;
-        }
-        case MessageType::FileData:
-        {
-            ui->chatDialogText->setTextColor(Qt::green);
-            break;
-        }
-        default:
-        {
-            ui->chatDialogText->setTextColor(Qt::white);
-            break;
-        }
+        clientListModel->clear();
     }
 
-    ui->chatDialogText->append(message);
-}
+    // Add and remove clients in the order they joined and left, the events are already batched
+    clientListModel->applyChanges(events.clientChanges);
 
-// Add a new client to the client list widget
-void Chat::addNewClientToUI(QString clientName)
-{
-    clientListModel->appendRow(new QStandardItem(clientName));
+    foreach(QString fileName, events.sharedFiles)
+    {
+        addNewSharedFileToUI(fileName);
+    }
+
+    // Only the latest progress of the batch is shown
+    if(events.progress >= 0)
+    {
+        updateLoadingBar(events.progress);
+    }
+
+    // The next page is fetched once the names of this one are in the client list, unless it brought none
+    if(events.rosterPageReceived && events.clientChanges.isEmpty())
+    {
+        fetchMoreClients();
+    }
 }
 
-// Delete a client from the client list widget
-void Chat::deleteClientFromUI(QString clientName)
+// Add dialog lines to the chat dialog, their color is picked by the delegate from the message type
+void Chat::addDialogsToUI(const QList<QPair<MessageType, QString>> &messages)
 {
-    for(int i = 0; i < clientListModel->rowCount(); i++)
+    if(messages.isEmpty())
     {
-        if(clientListModel->item(i)->text() == clientName)
-        {
-            clientListModel->removeRow(i);
-            break;
-        }
+        return;
+    }
+
+    // Follow new messages unless the user has scrolled up
+    QScrollBar *scrollBar = ui->chatDialogList->verticalScrollBar();
+    bool atBottom = scrollBar->value() == scrollBar->maximum();
+
+    chatHistoryModel->addMessages(messages);
+
+    if(atBottom)
+    {
+        ui->chatDialogList->scrollToBottom();
     }
 }
 
@@ -143,14 +162,14 @@ void Chat::on_action_sendButton_clicked()
     if(!message.isEmpty())
     {
         message.prepend(clientName + "> ");
-        tcpManager->sendMessage(MessageType::Text, message.toUtf8());
+        emit sendMessageRequested(MessageType::Text, message.toUtf8());
         ui->messageInputText->clear();
     }
 
     // Send the attached files to the server
     if(!filePathList.isEmpty())
     {
-        tcpManager->readFiles(filePathList);
+        emit uploadRequested(filePathList);
     }
 
     // Clear the list of attached files
@@ -182,11 +201,21 @@ void Chat::removeAttachFile(QListWidgetItem* item)
 void Chat::downloadFile(QListWidgetItem* item)
 {
     QString fileName = item->text();
-    tcpManager->requestFile(fileName);
+    emit downloadRequested(fileName);
 }
 
-// Display an error message box when the connection fails
-void Chat::displayError()
+// Show in the title whether the connection is being opened again, messages sent meanwhile go out once it is back
+void Chat::updateConnectionState(bool connected)
 {
-    QMessageBox::critical(this, "Error", "Could not connect to server");
+    this->setWindowTitle(connected ? "Chat Application" : "Chat Application (reconnecting...)");
+}
+
+// Request the next page of the roster once the client list is scrolled close to its end or is not full yet
+void Chat::fetchMoreClients()
+{
+    QScrollBar *scrollBar = ui->clientList->verticalScrollBar();
+    if(scrollBar->value() >= scrollBar->maximum() - scrollBar->pageStep())
+    {
+        emit rosterPageRequested();
+    }
 }
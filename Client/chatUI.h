@@ -7,7 +7,10 @@
 #include <QtGui>
 #include <QtWidgets>
 
-#include "tcp_manager_thread.h"
+#include "tcp_manager.h"
+#include "client_list_model.h"
+#include "chat_history_model.h"
+#include "chat_message_delegate.h"
 
 namespace Ui {
 class Chat;
@@ -19,27 +22,36 @@ class Chat : public QWidget
 
 public:
     explicit Chat(QWidget *parent = nullptr);
-    Chat(QTcpSocket *socket, QString clientName, QWidget *parent = nullptr);
+    Chat(QTcpSocket *socket, QString clientName, int downloadStreams, QWidget *parent = nullptr);
     ~Chat();
 
+signals:
+    // Requests to the network thread, they are queued to it
+    void sendMessageRequested(MessageType type, QByteArray message);
+    void uploadRequested(QStringList filePaths);
+    void downloadRequested(QString fileName);
+    void rosterPageRequested();
+
 private slots:
-    void addDialogToUI(MessageType type, QString message);
-    void addNewClientToUI(QString clientName);
-    void deleteClientFromUI(QString clientName);
+    void handleEvents(ChatEvents events);
+    void addDialogsToUI(const QList<QPair<MessageType, QString>> &messages);
     void addNewSharedFileToUI(QString fileName);
     void on_action_attachFileButton_clicked();
     void on_action_sendButton_clicked();
     void updateLoadingBar(qint64 numBytes);
     void removeAttachFile(QListWidgetItem* item);
     void downloadFile(QListWidgetItem* item);
-    void displayError();
+    void updateConnectionState(bool connected);
+    void fetchMoreClients();
 
 private:
     Ui::Chat *ui;
     QTimer *loadingBarResetTimer;
-    TCPManagerThread *tcpManager;
+    QThread *networkThread;
+    TCPManager *tcpManager;
     QString clientName;
-    QStandardItemModel *clientListModel;
+    ClientListModel *clientListModel;
+    ChatHistoryModel *chatHistoryModel;
     QList<QString> filePathList;
 };
 
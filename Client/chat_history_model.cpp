@@ -0,0 +1,152 @@
+#include "chat_history_model.h"
+
+#include <QDataStream>
+#include <QDebug>
+
+ChatHistoryModel::ChatHistoryModel(int memoryLimit, QObject *parent)
+    : QAbstractListModel(parent)
+{
+    this->memoryLimit = qMax(memoryLimit, CHAT_HISTORY_BLOCK_SIZE);
+    this->numSpilled = 0;
+    this->cachedBlockIndex = -1;
+}
+
+int ChatHistoryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : numSpilled + messages.size();
+}
+
+QVariant ChatHistoryModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount())
+    {
+        return QVariant();
+    }
+
+    const Message &row = message(index.row());
+    switch (role)
+    {
+        case Qt::DisplayRole:
+        case Qt::ToolTipRole:
+        {
+            return row.text;
+        }
+        case TypeRole:
+        {
+            return int(row.type);
+        }
+        default:
+        {
+            return QVariant();
+        }
+    }
+}
+
+// Append messages as the last rows, the view is updated once for all of them
+// The oldest messages are moved to disk once there are too many in memory
+void ChatHistoryModel::addMessages(const QList<QPair<MessageType, QString>> &newMessages)
+{
+    if(newMessages.isEmpty())
+    {
+        return;
+    }
+
+    int row = rowCount();
+    beginInsertRows(QModelIndex(), row, row + newMessages.size() - 1);
+    for(const QPair<MessageType, QString> &newMessage : newMessages)
+    {
+        messages.append({newMessage.first, newMessage.second});
+    }
+    endInsertRows();
+
+    spillBlocks();
+}
+
+// Change the number of messages kept in memory
+void ChatHistoryModel::setMemoryLimit(int memoryLimit)
+{
+    this->memoryLimit = qMax(memoryLimit, CHAT_HISTORY_BLOCK_SIZE);
+    spillBlocks();
+}
+
+// Get the message of a row, from memory or from the block on disk holding it
+const ChatHistoryModel::Message &ChatHistoryModel::message(int row) const
+{
+    if(row >= numSpilled)
+    {
+        return messages[row - numSpilled];
+    }
+
+    int block = row / CHAT_HISTORY_BLOCK_SIZE;
+    if(block != cachedBlockIndex && !readBlock(block))
+    {
+        static const Message missing = {MessageType::Text, QString()};
+        return missing;
+    }
+    return cachedBlock[row % CHAT_HISTORY_BLOCK_SIZE];
+}
+
+// Move the oldest messages to disk, a whole block at a time, while more than the limit are in memory
+// The rows stay the same, only where their messages are kept changes
+void ChatHistoryModel::spillBlocks()
+{
+    while(messages.size() >= memoryLimit + CHAT_HISTORY_BLOCK_SIZE)
+    {
+        if(!spillFile.isOpen() && !spillFile.open())
+        {
+            qDebug() << "Could not open the chat history file:" << spillFile.errorString();
+            return;
+        }
+
+        QByteArray block;
+        QDataStream stream(&block, QIODevice::WriteOnly);
+        for(int i = 0; i < CHAT_HISTORY_BLOCK_SIZE; i++)
+        {
+            stream << quint8(messages[i].type) << messages[i].text;
+        }
+
+        // Blocks are only ever appended to the end of the file
+        qint64 offset = spillFile.size();
+        if(!spillFile.seek(offset) || spillFile.write(block) != block.size())
+        {
+            qDebug() << "Could not write the chat history file:" << spillFile.errorString();
+            return;
+        }
+
+        blockOffsets.append(offset);
+        messages.remove(0, CHAT_HISTORY_BLOCK_SIZE);
+        numSpilled += CHAT_HISTORY_BLOCK_SIZE;
+    }
+}
+
+// Read a block of messages back from disk into the cache
+bool ChatHistoryModel::readBlock(int block) const
+{
+    qint64 offset = blockOffsets[block];
+    qint64 end = block + 1 < blockOffsets.size() ? blockOffsets[block + 1] : spillFile.size();
+    if(!spillFile.seek(offset))
+    {
+        return false;
+    }
+
+    QByteArray data = spillFile.read(end - offset);
+    QDataStream stream(data);
+    cachedBlock.clear();
+    cachedBlock.reserve(CHAT_HISTORY_BLOCK_SIZE);
+    for(int i = 0; i < CHAT_HISTORY_BLOCK_SIZE; i++)
+    {
+        quint8 type;
+        QString text;
+        stream >> type >> text;
+        cachedBlock.append({MessageType(type), text});
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        cachedBlockIndex = -1;
+        return false;
+    }
+
+    cachedBlockIndex = block;
+    return true;
+}
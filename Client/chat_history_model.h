@@ -0,0 +1,57 @@
+#ifndef CHAT_HISTORY_MODEL_H
+#define CHAT_HISTORY_MODEL_H
+
+#include <QAbstractListModel>
+#include <QTemporaryFile>
+#include <QList>
+#include <QString>
+#include <QPair>
+
+#include "header.h"
+
+// Default number of messages kept in memory, older ones are moved to a file on disk
+#define CHAT_HISTORY_MEMORY_LIMIT 10000
+
+// Messages are moved to disk this many at a time, the file keeps the offset of every block of them
+#define CHAT_HISTORY_BLOCK_SIZE 256
+
+// Messages shown in the chat dialog
+// Only the newest messages are kept in memory, older ones are read back from disk a block at a time when scrolled to
+class ChatHistoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    // The message type of a row, the delegate picks the color of the message from it
+    enum Roles
+    {
+        TypeRole = Qt::UserRole
+    };
+
+    explicit ChatHistoryModel(int memoryLimit = CHAT_HISTORY_MEMORY_LIMIT, QObject *parent = nullptr);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    void addMessages(const QList<QPair<MessageType, QString>> &newMessages);
+    void setMemoryLimit(int memoryLimit);
+
+private:
+    struct Message
+    {
+        MessageType type;
+        QString text;
+    };
+
+    const Message &message(int row) const;
+    void spillBlocks();
+    bool readBlock(int block) const;
+
+    QList<Message> messages;
+    int memoryLimit;
+    int numSpilled;
+    QList<qint64> blockOffsets;
+    mutable QTemporaryFile spillFile;
+    mutable QList<Message> cachedBlock;
+    mutable int cachedBlockIndex;
+};
+
+#endif // CHAT_HISTORY_MODEL_H
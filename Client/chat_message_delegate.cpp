@@ -0,0 +1,95 @@
+#include "chat_message_delegate.h"
+#include "chat_history_model.h"
+
+#include <QPainter>
+#include <QAbstractItemView>
+#include <QtMath>
+
+// Space in pixels around the text of a message
+#define CHAT_MESSAGE_MARGIN 4
+
+ChatMessageDelegate::ChatMessageDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void ChatMessageDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    QStyleOptionViewItem itemOption = option;
+    initStyleOption(&itemOption, index);
+
+    painter->save();
+    if(itemOption.state & QStyle::State_Selected)
+    {
+        painter->fillRect(itemOption.rect, itemOption.palette.highlight());
+    }
+
+    // Long messages are wrapped onto as many lines as they need, the text takes the pen's color
+    QTextLayout layout(itemOption.text, itemOption.font);
+    layoutText(layout, itemOption.rect.width() - 2 * CHAT_MESSAGE_MARGIN);
+    painter->setPen(messageColor(MessageType(index.data(ChatHistoryModel::TypeRole).toInt())));
+    layout.draw(painter, itemOption.rect.topLeft() + QPointF(CHAT_MESSAGE_MARGIN, CHAT_MESSAGE_MARGIN / 2));
+    painter->restore();
+}
+
+// Height of the message wrapped to the width of the view
+QSize ChatMessageDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    int width = textWidth(option);
+    QString text = index.data(Qt::DisplayRole).toString();
+
+    // Most messages fit on one line and do not need to be laid out
+    int lineHeight = option.fontMetrics.height() + CHAT_MESSAGE_MARGIN;
+    if(option.fontMetrics.horizontalAdvance(text) <= width)
+    {
+        return QSize(width + 2 * CHAT_MESSAGE_MARGIN, lineHeight);
+    }
+
+    QTextLayout layout(text, option.font);
+    qreal height = layoutText(layout, width);
+    return QSize(width + 2 * CHAT_MESSAGE_MARGIN, qCeil(height) + CHAT_MESSAGE_MARGIN);
+}
+
+// Break the text into lines no wider than width and return their total height
+qreal ChatMessageDelegate::layoutText(QTextLayout &layout, qreal width)
+{
+    QTextOption textOption;
+    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout.setTextOption(textOption);
+
+    qreal height = 0;
+    layout.beginLayout();
+    for(QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine())
+    {
+        line.setLineWidth(qMax<qreal>(width, 1));
+        line.setPosition(QPointF(0, height));
+        height += line.height();
+    }
+    layout.endLayout();
+    return height;
+}
+
+// Width the text of a message is wrapped to, the view's rows take its whole width
+int ChatMessageDelegate::textWidth(const QStyleOptionViewItem &option)
+{
+    const QAbstractItemView *view = qobject_cast<const QAbstractItemView *>(option.widget);
+    int width = view ? view->viewport()->width() : option.rect.width();
+    return qMax(width - 2 * CHAT_MESSAGE_MARGIN, 1);
+}
+
+// Color of a message of a type, the chat's own events are shown apart from what the clients write
+QColor ChatMessageDelegate::messageColor(MessageType type)
+{
+    switch (type)
+    {
+        case MessageType::Connection:
+        case MessageType::Disconnection:
+            return QColor(Qt::gray);
+        case MessageType::FileInfo:
+            return QColor(Qt::cyan);
+        case MessageType::FileData:
+            return QColor(Qt::green);
+        default:
+            return QColor(Qt::white);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef CHAT_MESSAGE_DELEGATE_H
+#define CHAT_MESSAGE_DELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QTextLayout>
+#include <QColor>
+
+#include "header.h"
+
+// Draws a message wrapped to the width of the view in the color of its type
+// Long words are broken where they do not fit, so the whole of every message can be read
+class ChatMessageDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit ChatMessageDelegate(QObject *parent = nullptr);
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    static qreal layoutText(QTextLayout &layout, qreal width);
+    static int textWidth(const QStyleOptionViewItem &option);
+    static QColor messageColor(MessageType type);
+};
+
+#endif // CHAT_MESSAGE_DELEGATE_H
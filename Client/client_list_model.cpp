@@ -0,0 +1,152 @@
+#include "client_list_model.h"
+
+ClientListModel::ClientListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int ClientListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : names.size();
+}
+
+QVariant ClientListModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= names.size() || role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    return names[index.row()];
+}
+
+// Apply a batch of joins (true) and leaves (false) in the order they were made
+// Leaves take the rows out in place so the others keep their order, joins are added at the end
+// Names that leave without being in the list are ignored
+void ClientListModel::applyChanges(const QList<QPair<QString, bool>> &changes)
+{
+    if(changes.isEmpty())
+    {
+        return;
+    }
+
+    // Work out the rows of the batch first, joins get the rows after the current ones
+    int numRows = names.size();
+    QList<QString> joined;
+    QList<bool> removed(numRows, false);
+    bool anyRemoved = false;
+    for(const QPair<QString, bool> &change : changes)
+    {
+        if(change.second)
+        {
+            rows.insert(change.first, numRows + joined.size());
+            joined.append(change.first);
+            removed.append(false);
+            continue;
+        }
+
+        auto it = rows.find(change.first);
+        if(it != rows.end())
+        {
+            removed[it.value()] = true;
+            rows.erase(it);
+            anyRemoved = true;
+        }
+    }
+
+    // A large batch is applied without signalling each range and the view is laid out again once
+    bool reset = changes.size() > CLIENT_LIST_RESET_THRESHOLD;
+    if(reset)
+    {
+        beginResetModel();
+    }
+
+    takeRows(removed.mid(0, numRows), reset);
+
+    // The joins that did not leave again in the same batch are added in one range
+    QList<QString> added;
+    for(int i = 0; i < joined.size(); i++)
+    {
+        if(!removed[numRows + i])
+        {
+            added.append(joined[i]);
+        }
+    }
+    if(!added.isEmpty())
+    {
+        if(!reset)
+        {
+            beginInsertRows(QModelIndex(), names.size(), names.size() + added.size() - 1);
+        }
+        names.append(added);
+        if(!reset)
+        {
+            endInsertRows();
+        }
+    }
+
+    // Rows after a removed one have moved up, the index is built again for the next batch
+    if(anyRemoved)
+    {
+        rebuildIndex();
+    }
+
+    if(reset)
+    {
+        endResetModel();
+    }
+
+    emit changesApplied();
+}
+
+// Remove every client from the list right away
+void ClientListModel::clear()
+{
+    beginResetModel();
+    names.clear();
+    rows.clear();
+    endResetModel();
+}
+
+// Take the rows marked as removed out of the list, one contiguous range at a time from the last one
+// The view is only told about the ranges when the model is not being reset
+void ClientListModel::takeRows(const QList<bool> &removed, bool reset)
+{
+    int row = removed.size() - 1;
+    while(row >= 0)
+    {
+        if(!removed[row])
+        {
+            row--;
+            continue;
+        }
+
+        int last = row;
+        while(row > 0 && removed[row - 1])
+        {
+            row--;
+        }
+
+        if(!reset)
+        {
+            beginRemoveRows(QModelIndex(), row, last);
+        }
+        names.remove(row, last - row + 1);
+        if(!reset)
+        {
+            endRemoveRows();
+        }
+        row--;
+    }
+}
+
+// Map every name to its rows again
+void ClientListModel::rebuildIndex()
+{
+    rows.clear();
+    rows.reserve(names.size());
+    for(int row = 0; row < names.size(); row++)
+    {
+        rows.insert(names[row], row);
+    }
+}
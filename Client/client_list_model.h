@@ -0,0 +1,38 @@
+#ifndef CLIENT_LIST_MODEL_H
+#define CLIENT_LIST_MODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QMultiHash>
+#include <QPair>
+#include <QString>
+
+// Batches larger than this reset the model instead of signalling every range of rows, so the view is laid out once
+#define CLIENT_LIST_RESET_THRESHOLD 64
+
+// Names of the clients in the chat in the order they joined, with an index from each name to its rows
+// Changes come in the batches the network thread collects, the view hears about each batch at once
+class ClientListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit ClientListModel(QObject *parent = nullptr);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    void applyChanges(const QList<QPair<QString, bool>> &changes);
+    void clear();
+
+signals:
+    // Emitted once a batch of changes is in the model and the view has been told about it
+    void changesApplied();
+
+private:
+    void takeRows(const QList<bool> &removed, bool reset);
+    void rebuildIndex();
+
+    QList<QString> names;
+    QMultiHash<QString, int> rows;
+};
+
+#endif // CLIENT_LIST_MODEL_H
@@ -0,0 +1,314 @@
+#include "download_file.h"
+#include "crc32c.h"
+
+#include <QtEndian>
+#include <cstdio>
+#include <iterator>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <QDir>
+#include <windows.h>
+#endif
+
+DownloadFile::DownloadFile(QString filePath, qint64 bufferSize, BufferPool *pool)
+    : file(filePath + ".part"), hash(QCryptographicHash::Sha256)
+{
+    this->filePath = filePath;
+    this->pool = pool;
+    this->bufferSize = bufferSize;
+    this->writtenSize = 0;
+    this->resumeOffset = 0;
+    this->receivedSize = 0;
+    this->expectedSize = 0;
+    this->fileSize = -1;
+    this->parallel = false;
+}
+
+// An unfinished download keeps its part file so that it can carry on later
+// Ranges written after a gap are cut off, the part file only ever holds the data verified from its start
+DownloadFile::~DownloadFile()
+{
+    if(file.isOpen())
+    {
+        flushBuffer();
+        if(parallel)
+        {
+            file.resize(writtenSize);
+        }
+        file.close();
+    }
+
+    pool->release(buffer);
+}
+
+// Check a packet of the file against the checksum in its tail, servers that do not send checksums are trusted
+bool DownloadFile::checkChunk(QByteArrayView data, QByteArrayView tail)
+{
+    return tail.size() < CHUNK_CHECKSUM_SIZE || qFromLittleEndian<quint32>(tail.data()) == Crc32c::checksum(data);
+}
+
+// Open the part file and find where the download carries on from
+bool DownloadFile::open()
+{
+    buffer = pool->acquire(bufferSize);
+    if(buffer.isNull())
+    {
+        bufferSize = 0;
+    }
+
+    if(!file.open(QIODevice::ReadWrite))
+    {
+        return false;
+    }
+
+    // Only whole packets of an earlier attempt are kept, a packet cut short by the interruption is downloaded again
+    qint64 size = file.size() - file.size() % DATA_SIZE;
+    if(!file.resize(size) || !hashFile(size))
+    {
+        return false;
+    }
+
+    writtenSize = size;
+    resumeOffset = size;
+    receivedSize = size;
+    timer.start();
+    return true;
+}
+
+// Number of bytes received from the start of the file and checked against their checksums, the next request starts there
+qint64 DownloadFile::verifiedSize() const
+{
+    return writtenSize;
+}
+
+// Number of bytes kept from an earlier attempt when the download was opened
+qint64 DownloadFile::resumedFrom() const
+{
+    return resumeOffset;
+}
+
+// Percentage of a file split into ranges that has been received
+int DownloadFile::progress() const
+{
+    return expectedSize > 0 ? int(qMin<qint64>(receivedSize * 100 / expectedSize, 100)) : 0;
+}
+
+// Number of bytes of the file received by this download, without those kept from an earlier attempt
+qint64 DownloadFile::downloadedSize() const
+{
+    return qMax<qint64>(fileSize - resumeOffset, 0);
+}
+
+// Milliseconds since the download was opened
+qint64 DownloadFile::elapsed() const
+{
+    return timer.elapsed();
+}
+
+// Check a packet of the file against its checksum and add it to the end of the file
+// Packets that do not carry on from the end of the verified data are skipped, they belong to a range that was asked for again
+DownloadFile::WriteResult DownloadFile::write(qint64 offset, QByteArrayView data, QByteArrayView tail)
+{
+    if(parallel || offset != writtenSize)
+    {
+        return WriteResult::Skipped;
+    }
+
+    if(!checkChunk(data, tail))
+    {
+        return WriteResult::ChecksumError;
+    }
+
+    if(buffer.size() + data.size() > bufferSize && !flushBuffer())
+    {
+        return WriteResult::DiskError;
+    }
+
+    // Data larger than the buffer is written directly
+    if(data.size() >= bufferSize)
+    {
+        if(file.write(data.data(), data.size()) != data.size())
+        {
+            return WriteResult::DiskError;
+        }
+    }
+    else
+    {
+        buffer.append(data);
+    }
+
+    hash.addData(data);
+    writtenSize += data.size();
+    receivedSize += data.size();
+    return WriteResult::Written;
+}
+
+// Reserve the space of the whole file before its ranges are written in place
+// From here on the data only comes through writeAt and the file is hashed once it is complete
+// If the space cannot be reserved the download carries on through write from the end of the verified data
+bool DownloadFile::preallocate(qint64 size)
+{
+    if(!flushBuffer() || !file.flush())
+    {
+        return false;
+    }
+
+    bool reserved = size <= file.size();
+#ifdef Q_OS_LINUX
+    if(!reserved)
+    {
+        reserved = ::posix_fallocate(file.handle(), 0, size) == 0;
+    }
+#endif
+    if(!reserved)
+    {
+        reserved = file.resize(size);
+    }
+
+    // Give back whatever was reserved before the failure, the part file only holds the verified data
+    if(!reserved)
+    {
+        file.resize(writtenSize);
+        return false;
+    }
+
+    parallel = true;
+    expectedSize = size;
+    return true;
+}
+
+// Write checked data of one range in place, the ranges of the file may arrive in any order
+bool DownloadFile::writeAt(qint64 offset, QByteArrayView data)
+{
+    if(data.isEmpty())
+    {
+        return true;
+    }
+
+#ifdef Q_OS_UNIX
+    qint64 numBytes = ::pwrite(file.handle(), data.data(), data.size(), offset);
+#else
+    qint64 numBytes = file.seek(offset) ? file.write(data.data(), data.size()) : -1;
+#endif
+    if(numBytes != data.size())
+    {
+        return false;
+    }
+    receivedSize += data.size();
+
+    // Join the range to the one written before it, ranges are mostly written one after the other
+    qint64 end = offset + data.size();
+    auto it = writtenRanges.upperBound(offset);
+    if(it != writtenRanges.begin() && std::prev(it).value() >= offset)
+    {
+        --it;
+        it.value() = qMax(it.value(), end);
+    }
+    else
+    {
+        it = writtenRanges.insert(offset, end);
+    }
+
+    // Swallow the ranges it has grown into
+    auto next = std::next(it);
+    while(next != writtenRanges.end() && next.key() <= it.value())
+    {
+        it.value() = qMax(it.value(), next.value());
+        next = writtenRanges.erase(next);
+    }
+
+    // The verified data from the start of the file grows once the gap after it has been filled
+    auto first = writtenRanges.begin();
+    if(first.key() <= writtenSize)
+    {
+        writtenSize = qMax(writtenSize, first.value());
+        writtenRanges.erase(first);
+    }
+    return true;
+}
+
+// Keep the size and hash of the file, they come with its last packet
+void DownloadFile::setFileEnd(qint64 size, QByteArrayView fileHash)
+{
+    this->fileSize = size;
+    this->fileHash = fileHash.toByteArray();
+}
+
+// Check whether every byte of the file has been received
+bool DownloadFile::isComplete() const
+{
+    return fileSize >= 0 && writtenSize >= fileSize;
+}
+
+// Check the whole file against its hash and move it into place, a file that does not match is thrown away
+// Without a hash from the server the checked packets are all there is to go by
+bool DownloadFile::finish()
+{
+    bool written = flushBuffer();
+
+    // Ranges written in place are only hashed once they are all there, the space reserved past the end is given back
+    if(written && parallel)
+    {
+        hash.reset();
+        written = file.resize(fileSize) && hashFile(fileSize);
+    }
+    file.close();
+
+    if(!written || (!fileHash.isEmpty() && fileHash != hash.result()))
+    {
+        file.remove();
+        return false;
+    }
+
+    // The finished file replaces an older copy in one step, so there is always a complete file at its path
+    // If it cannot be moved the part file is kept and the older copy stays where it is
+#if defined(Q_OS_UNIX)
+    return ::rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(filePath).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    QString partPath = QDir::toNativeSeparators(file.fileName());
+    QString targetPath = QDir::toNativeSeparators(filePath);
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(partPath.utf16()), reinterpret_cast<const wchar_t *>(targetPath.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return file.rename(filePath);
+#endif
+}
+
+// Write the buffer to the part file
+bool DownloadFile::flushBuffer()
+{
+    if(buffer.isEmpty())
+    {
+        return true;
+    }
+
+    bool written = file.write(buffer.constData(), buffer.size()) == buffer.size();
+    buffer.resize(0);
+    return written;
+}
+
+// Add the first bytes of the part file to the hash
+bool DownloadFile::hashFile(qint64 size)
+{
+    if(!file.seek(0))
+    {
+        return false;
+    }
+
+    QByteArray block(qMax<qint64>(bufferSize, DATA_SIZE), Qt::Uninitialized);
+    while(file.pos() < size)
+    {
+        qint64 numBytes = file.read(block.data(), qMin<qint64>(block.size(), size - file.pos()));
+        if(numBytes <= 0)
+        {
+            return false;
+        }
+        hash.addData(QByteArrayView(block.constData(), numBytes));
+    }
+    return true;
+}
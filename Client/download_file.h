@@ -0,0 +1,67 @@
+#ifndef DOWNLOAD_FILE_H
+#define DOWNLOAD_FILE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QMap>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+
+#include "packet.h"
+#include "buffer_pool.h"
+
+// Download of one file, its packets go to a part file next to it which is renamed to the file once it is complete
+// The part file outlives an interrupted download, the download carries on after its last whole packet
+// Every packet is checked against its CRC-32C before it is written and the whole file against its hash at the end
+// A large file can be split into ranges fetched side by side, they are written in place into the preallocated part file
+class DownloadFile
+{
+public:
+    enum class WriteResult
+    {
+        Written,
+        Skipped,
+        ChecksumError,
+        DiskError
+    };
+
+    DownloadFile(QString filePath, qint64 bufferSize, BufferPool *pool);
+    ~DownloadFile();
+    static bool checkChunk(QByteArrayView data, QByteArrayView tail);
+    bool open();
+    qint64 verifiedSize() const;
+    qint64 resumedFrom() const;
+    int progress() const;
+    qint64 downloadedSize() const;
+    qint64 elapsed() const;
+    WriteResult write(qint64 offset, QByteArrayView data, QByteArrayView tail);
+    bool preallocate(qint64 size);
+    bool writeAt(qint64 offset, QByteArrayView data);
+    void setFileEnd(qint64 size, QByteArrayView fileHash);
+    bool isComplete() const;
+    bool finish();
+
+private:
+    bool flushBuffer();
+    bool hashFile(qint64 size);
+
+    QString filePath;
+    QFile file;
+    BufferPool *pool;
+    QByteArray buffer;
+    qint64 bufferSize;
+    QCryptographicHash hash;
+    qint64 writtenSize;
+    qint64 resumeOffset;
+    qint64 receivedSize;
+    qint64 expectedSize;
+    qint64 fileSize;
+    QByteArray fileHash;
+    bool parallel;
+    QMap<qint64, qint64> writtenRanges;
+    QElapsedTimer timer;
+};
+
+#endif // DOWNLOAD_FILE_H
@@ -0,0 +1,216 @@
+#include "download_stream.h"
+
+#include <QDebug>
+
+// The range runs from offset up to end, an end of 0 runs to the end of the file
+DownloadStream::DownloadStream(const QString &host, quint16 port, const QString &fileName, DownloadFile *download, qint64 offset,
+                               qint64 end, BufferPool *pool, QObject *parent)
+    : QObject(parent)
+{
+    this->socket = new QTcpSocket(this);
+    this->host = host;
+    this->port = port;
+    this->name = fileName;
+    this->nameData = fileName.toUtf8();
+    this->download = download;
+    this->pool = pool;
+    this->position = offset;
+    this->end = end;
+    this->done = false;
+
+    // Received data is collected and written in place a buffer at a time
+    this->bufferSize = DOWNLOAD_STREAM_BUFFER_SIZE;
+    this->buffer = pool->acquire(bufferSize);
+    if(buffer.isNull())
+    {
+        this->bufferSize = 0;
+    }
+
+    this->retryDelay = DOWNLOAD_STREAM_RETRY_DELAY;
+    this->numRetries = 0;
+    this->retryTimer = new QTimer(this);
+    retryTimer->setSingleShot(true);
+    connect(retryTimer, &QTimer::timeout, this, &DownloadStream::reconnect);
+
+    connect(socket, &QTcpSocket::connected, this, &DownloadStream::connected);
+    connect(socket, &QTcpSocket::readyRead, this, &DownloadStream::readData);
+    connect(socket, &QTcpSocket::disconnected, this, &DownloadStream::connectionLost);
+    connect(socket, &QTcpSocket::errorOccurred, this, &DownloadStream::connectionLost);
+
+    socket->connectToHost(host, port);
+}
+
+DownloadStream::~DownloadStream()
+{
+    pool->release(buffer);
+}
+
+// Name of the file the range belongs to
+QString DownloadStream::fileName() const
+{
+    return name;
+}
+
+// Download the range is written to
+DownloadFile *DownloadStream::file() const
+{
+    return download;
+}
+
+// Write what has been received and close the connection, the download may be deleted after this
+void DownloadStream::close()
+{
+    if(!done)
+    {
+        flushBuffer();
+        done = true;
+    }
+
+    retryTimer->stop();
+    socket->disconnect(this);
+    socket->abort();
+}
+
+// Ask for the rest of the range
+void DownloadStream::connected()
+{
+    frameDecoder = FrameDecoder();
+    requestRange();
+}
+
+// Check every packet of the range and write it in place in the file
+void DownloadStream::readData()
+{
+    QByteArrayView frame;
+
+    frameDecoder.readFrom(socket);
+    while(!done && frameDecoder.nextFrame(frame))
+    {
+        PacketView packet(frame);
+        const Header &header = packet.header;
+        if(!packet.valid || header.type != MessageType::FileData || header.fileNameView() != nameData)
+        {
+            continue;
+        }
+
+        // Packets left over from a request made before a checksum error are skipped
+        qint64 offset = qint64(header.no - 1) * DATA_SIZE;
+        if(offset != position)
+        {
+            continue;
+        }
+
+        if(!DownloadFile::checkChunk(packet.data, packet.tail))
+        {
+            qDebug() << "Checksum error in packet" << header.no << "of" << name << ", downloading it again";
+            requestRange();
+            continue;
+        }
+
+        // Data larger than the buffer is written directly
+        if(buffer.size() + packet.data.size() > bufferSize && !flushBuffer())
+        {
+            stop(false);
+            return;
+        }
+        if(packet.data.size() >= bufferSize)
+        {
+            if(!download->writeAt(position, packet.data))
+            {
+                stop(false);
+                return;
+            }
+        }
+        else
+        {
+            buffer.append(packet.data);
+        }
+        position += packet.data.size();
+
+        // The connection works again, a later loss starts over with the shortest delay
+        retryDelay = DOWNLOAD_STREAM_RETRY_DELAY;
+        numRetries = 0;
+
+        // The last packet of the file tells its size and carries its hash
+        if(header.no == header.totalPacket)
+        {
+            QByteArrayView fileHash;
+            if(packet.tail.size() >= CHUNK_CHECKSUM_SIZE + FILE_HASH_SIZE)
+            {
+                fileHash = packet.tail.sliced(CHUNK_CHECKSUM_SIZE, FILE_HASH_SIZE);
+            }
+            download->setFileEnd(position, fileHash);
+        }
+
+        if(header.no == header.totalPacket || (end > 0 && position >= end))
+        {
+            stop(flushBuffer());
+            return;
+        }
+    }
+
+    emit progressed(this);
+}
+
+// Keep what has been received and connect again after a delay, unless the range is complete
+// The range fails once too many attempts in a row received nothing, the download keeps its verified data for later
+void DownloadStream::connectionLost()
+{
+    if(done || retryTimer->isActive())
+    {
+        return;
+    }
+
+    bool written = flushBuffer();
+    if(!written || numRetries >= DOWNLOAD_STREAM_MAX_RETRIES)
+    {
+        qDebug() << "Giving up on a range of" << name << "after" << numRetries << "attempts to connect again";
+        stop(false);
+        return;
+    }
+
+    numRetries++;
+    retryTimer->start(retryDelay);
+    retryDelay *= 2;
+}
+
+// Open the connection to the server again
+void DownloadStream::reconnect()
+{
+    socket->abort();
+    socket->connectToHost(host, port);
+}
+
+// Ask the server for the packets from the current position up to the end of the range
+void DownloadStream::requestRange()
+{
+    FileRange range;
+    range.offset = position;
+    range.length = end > 0 ? end - position : 0;
+
+    Header header(MessageType::FileInfo, name, FILE_RANGE_SIZE, 1, 1);
+    socket->write(Frame::encode(header, range.toData(), HeaderFormat::Binary));
+}
+
+// Write the buffer in place, it holds the data received just before the current position
+bool DownloadStream::flushBuffer()
+{
+    if(buffer.isEmpty())
+    {
+        return true;
+    }
+
+    bool written = download->writeAt(position - buffer.size(), buffer);
+    buffer.resize(0);
+    return written;
+}
+
+// Close the connection once the range is complete or cannot be written
+void DownloadStream::stop(bool written)
+{
+    done = true;
+    retryTimer->stop();
+    socket->disconnect(this);
+    socket->abort();
+    emit finished(this, written);
+}
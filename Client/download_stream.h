@@ -0,0 +1,70 @@
+#ifndef DOWNLOAD_STREAM_H
+#define DOWNLOAD_STREAM_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "packet.h"
+#include "frame.h"
+#include "download_file.h"
+#include "buffer_pool.h"
+
+// Delay in milliseconds before a lost download stream connects again, it doubles after every attempt that receives nothing
+#define DOWNLOAD_STREAM_RETRY_DELAY 1000
+
+// Attempts to connect again in a row without receiving anything before the range is given up
+#define DOWNLOAD_STREAM_MAX_RETRIES 5
+
+// Bytes of a range collected before they are written in place
+#define DOWNLOAD_STREAM_BUFFER_SIZE (64 * 1024)
+
+// Extra connection to the server fetching one range of a download, the ranges of a file are fetched side by side
+// It does not log in, it only asks for its range and writes the packets in place in the file as they are checked
+// A lost connection is opened again after a delay and asks for the rest of the range, the download fails once it keeps failing
+class DownloadStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    DownloadStream(const QString &host, quint16 port, const QString &fileName, DownloadFile *download, qint64 offset, qint64 end,
+                   BufferPool *pool, QObject *parent = nullptr);
+    ~DownloadStream();
+    QString fileName() const;
+    DownloadFile *file() const;
+    void close();
+
+signals:
+    void progressed(DownloadStream *stream);
+    void finished(DownloadStream *stream, bool written);
+
+private slots:
+    void connected();
+    void readData();
+    void connectionLost();
+    void reconnect();
+
+private:
+    void requestRange();
+    bool flushBuffer();
+    void stop(bool written);
+
+    QTcpSocket *socket;
+    QString host;
+    quint16 port;
+    QString name;
+    QByteArray nameData;
+    DownloadFile *download;
+    FrameDecoder frameDecoder;
+    BufferPool *pool;
+    QByteArray buffer;
+    qint64 bufferSize;
+    qint64 position;
+    qint64 end;
+    bool done;
+    QTimer *retryTimer;
+    int retryDelay;
+    int numRetries;
+};
+
+#endif // DOWNLOAD_STREAM_H
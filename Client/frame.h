@@ -0,0 +1,317 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QtEndian>
+#include <cstring>
+
+#include "packet.h"
+
+// Frame layout: start byte, magic byte, little-endian uint32 payload length,
+// CRC-16 of the payload and CRC-16 of the first 8 bytes of the frame header
+#define FRAME_MAGIC 0xC4
+#define FRAME_HEADER_SIZE 10
+#define MAX_FRAME_SIZE (16 * 1024 * 1024)
+
+// Text-format clients frame packets with a big-endian uint32 length in front of the start byte
+#define LEGACY_PREFIX_SIZE 4
+#define LEGACY_TEXT_BYTE 'T'
+
+namespace FrameLayout
+{
+    constexpr int StartByte = 0;
+    constexpr int Magic = 1;
+    constexpr int Length = 2;
+    constexpr int PayloadChecksum = 6;
+    constexpr int HeaderChecksum = 8;
+}
+
+namespace Frame
+{
+    // Encode a header and its data into frame, the bytes written to the socket
+    // The frame is written in place so that a buffer kept by the caller is reused without allocating
+    // The tail goes after the data in binary frames only, text-format clients would read it as data
+    inline void encodeInto(QByteArray &frame, const Header &header, QByteArrayView data, HeaderFormat format,
+                           QByteArrayView tail = QByteArrayView())
+    {
+        // Text-format clients expect the QDataStream framing they were built with
+        // and data padded to a fixed size unless it fills a whole packet
+        if(format == HeaderFormat::Text)
+        {
+            qsizetype dataSize = data.size() == DATA_SIZE ? DATA_SIZE : DATA_SIZE + TAIL_SIZE;
+            frame.resize(LEGACY_PREFIX_SIZE + HEADER_SIZE + dataSize);
+            memset(frame.data() + LEGACY_PREFIX_SIZE, 0, HEADER_SIZE + dataSize);
+            qToBigEndian<quint32>(HEADER_SIZE + dataSize, frame.data());
+
+            QByteArray headerData = header.toByteArray(HeaderFormat::Text);
+            memcpy(frame.data() + LEGACY_PREFIX_SIZE, headerData.constData(), HEADER_SIZE);
+            if(!data.isEmpty())
+            {
+                memcpy(frame.data() + LEGACY_PREFIX_SIZE + HEADER_SIZE, data.data(), qMin(data.size(), dataSize));
+            }
+            return;
+        }
+
+        // Binary headers are followed directly by the data and the tail
+        frame.resize(FRAME_HEADER_SIZE + HEADER_SIZE + data.size() + tail.size());
+        char *payload = frame.data() + FRAME_HEADER_SIZE;
+        qsizetype payloadSize = header.encode(payload);
+        if(!data.isEmpty())
+        {
+            memcpy(payload + payloadSize, data.data(), data.size());
+            payloadSize += data.size();
+        }
+        if(!tail.isEmpty())
+        {
+            memcpy(payload + payloadSize, tail.data(), tail.size());
+            payloadSize += tail.size();
+        }
+        frame.resize(FRAME_HEADER_SIZE + payloadSize);
+
+        char *frameHeader = frame.data();
+        frameHeader[FrameLayout::StartByte] = START_BYTE;
+        frameHeader[FrameLayout::Magic] = char(FRAME_MAGIC);
+        qToLittleEndian<quint32>(payloadSize, frameHeader + FrameLayout::Length);
+        qToLittleEndian<quint16>(qChecksum(QByteArrayView(frameHeader + FRAME_HEADER_SIZE, payloadSize)),
+                                 frameHeader + FrameLayout::PayloadChecksum);
+        qToLittleEndian<quint16>(qChecksum(QByteArrayView(frameHeader, FrameLayout::HeaderChecksum)), frameHeader + FrameLayout::HeaderChecksum);
+    }
+
+    // Encode a header and its data into a new frame, the data is copied once straight into it
+    inline QByteArray encode(const Header &header, QByteArrayView data, HeaderFormat format)
+    {
+        QByteArray frame;
+        encodeInto(frame, header, data, format);
+        return frame;
+    }
+
+    // Encode a packet into the bytes written to the socket
+    inline QByteArray encode(const Packet &packet, HeaderFormat format)
+    {
+        return encode(packet.header, packet.data, format);
+    }
+}
+
+// A packet encoded once and shared by all of its recipients
+// The text format is only encoded when a recipient using it is found, from the data kept in the binary frame
+class EncodedPacket
+{
+public:
+    EncodedPacket(const Header &header, QByteArrayView data) {
+        this->header = header;
+        this->binaryFrame = Frame::encode(header, data, HeaderFormat::Binary);
+        this->dataOffset = binaryFrame.size() - data.size();
+    }
+
+    EncodedPacket(const Packet &packet)
+        : EncodedPacket(packet.header, packet.data)
+    {
+    }
+
+    MessageType type() const
+    {
+        return header.type;
+    }
+
+    // Get the frame for a recipient, copies share the same bytes
+    QByteArray frame(HeaderFormat format)
+    {
+        if(format == HeaderFormat::Binary)
+        {
+            return binaryFrame;
+        }
+
+        if(textFrame.isNull())
+        {
+            textFrame = Frame::encode(header, QByteArrayView(binaryFrame).sliced(dataOffset), HeaderFormat::Text);
+        }
+        return textFrame;
+    }
+
+private:
+    Header header;
+    QByteArray binaryFrame;
+    qsizetype dataOffset;
+    QByteArray textFrame;
+};
+
+// Per-connection decoder that buffers received bytes and only hands out complete, valid frames
+// On a corrupt or unknown frame it drops one byte and resynchronizes on the next start byte
+class FrameDecoder
+{
+public:
+    FrameDecoder() {
+        this->head = 0;
+        this->droppedBytes = 0;
+    }
+
+    // Append everything the device has received to the buffer
+    qint64 readFrom(QIODevice *device)
+    {
+        compact();
+
+        qint64 available = device->bytesAvailable();
+        if(available <= 0)
+        {
+            return 0;
+        }
+
+        qsizetype oldSize = buffer.size();
+        buffer.resize(oldSize + available);
+        qint64 numBytes = device->read(buffer.data() + oldSize, available);
+        buffer.resize(oldSize + qMax<qint64>(numBytes, 0));
+
+        return numBytes;
+    }
+
+    // Append raw bytes to the buffer
+    void append(const QByteArray &bytes)
+    {
+        compact();
+        buffer.append(bytes);
+    }
+
+    // Extract the payload of the next complete frame, return false if more data is needed
+    bool nextFrame(QByteArray &payload)
+    {
+        QByteArrayView frameData;
+        if(!nextFrame(frameData))
+        {
+            return false;
+        }
+
+        payload = frameData.toByteArray();
+        return true;
+    }
+
+    // Point payload at the next complete frame in the buffer without copying it, return false if more data is needed
+    // The view stays valid until the next call to readFrom or append
+    bool nextFrame(QByteArrayView &payload)
+    {
+        while(buffer.size() - head >= 2)
+        {
+            const char *data = buffer.constData() + head;
+            qsizetype available = buffer.size() - head;
+
+            // Find the next start byte, nothing before it can begin a frame
+            // The last bytes are kept since they may be the length prefix of a text-format frame
+            const char *start = static_cast<const char *>(memchr(data, START_BYTE, available));
+            if(!start)
+            {
+                skip(qMax<qsizetype>(available - LEGACY_PREFIX_SIZE, 0));
+                return false;
+            }
+
+            qsizetype offset = start - data;
+            if(offset + 1 >= available)
+            {
+                skip(qMax<qsizetype>(offset - LEGACY_PREFIX_SIZE, 0));
+                return false;
+            }
+
+            // Binary frame
+            if(quint8(start[FrameLayout::Magic]) == FRAME_MAGIC)
+            {
+                skip(offset);
+                if(available - offset < FRAME_HEADER_SIZE)
+                {
+                    return false;
+                }
+
+                quint32 length = qFromLittleEndian<quint32>(start + FrameLayout::Length);
+                quint16 headerChecksum = qFromLittleEndian<quint16>(start + FrameLayout::HeaderChecksum);
+                if(length > MAX_FRAME_SIZE || headerChecksum != qChecksum(QByteArrayView(start, FrameLayout::HeaderChecksum)))
+                {
+                    skip(1);
+                    continue;
+                }
+
+                if(available - offset < FRAME_HEADER_SIZE + qsizetype(length))
+                {
+                    return false;
+                }
+
+                QByteArrayView frameData(start + FRAME_HEADER_SIZE, length);
+                if(qFromLittleEndian<quint16>(start + FrameLayout::PayloadChecksum) != qChecksum(frameData))
+                {
+                    skip(1);
+                    continue;
+                }
+
+                payload = frameData;
+                consume(FRAME_HEADER_SIZE + length);
+                return true;
+            }
+
+            // Text-format frame, sized by the length prefix in front of the start byte
+            if(start[1] == LEGACY_TEXT_BYTE && offset >= LEGACY_PREFIX_SIZE)
+            {
+                quint32 length = qFromBigEndian<quint32>(start - LEGACY_PREFIX_SIZE);
+                if(length >= HEADER_SIZE && length <= HEADER_SIZE + DATA_SIZE + TAIL_SIZE)
+                {
+                    skip(offset - LEGACY_PREFIX_SIZE);
+                    if(available - offset < qsizetype(length))
+                    {
+                        return false;
+                    }
+
+                    payload = QByteArrayView(start, length);
+                    consume(LEGACY_PREFIX_SIZE + length);
+                    return true;
+                }
+            }
+
+            // Not a frame start, skip past it
+            skip(offset + 1);
+        }
+
+        return false;
+    }
+
+    // Number of bytes skipped while resynchronizing
+    qint64 dropped() const
+    {
+        return droppedBytes;
+    }
+
+private:
+    // Move past a decoded frame
+    void consume(qsizetype numBytes)
+    {
+        head += numBytes;
+    }
+
+    // Move past bytes that do not belong to any frame
+    void skip(qsizetype numBytes)
+    {
+        head += numBytes;
+        droppedBytes += numBytes;
+    }
+
+    // Reclaim the space before the current position once it makes up half of the buffer
+    void compact()
+    {
+        if(head == 0)
+        {
+            return;
+        }
+
+        if(head >= buffer.size())
+        {
+            buffer.resize(0);
+            head = 0;
+        }
+        else if(head >= buffer.size() / 2)
+        {
+            buffer.remove(0, head);
+            head = 0;
+        }
+    }
+
+    QByteArray buffer;
+    qsizetype head;
+    qint64 droppedBytes;
+};
+
+#endif // FRAME_H
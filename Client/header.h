@@ -2,11 +2,17 @@
 #define HEADER_H
 
 #include <QString>
-#include <QList>
-#include <QtCore>
+#include <QByteArray>
+#include <QtEndian>
+#include <QStringEncoder>
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
 
 #define HEADER_SIZE 128
 #define START_BYTE 0x1F
+#define HEADER_VERSION 0x02
 
 enum MessageType
 {
@@ -14,87 +20,244 @@ enum MessageType
     Disconnection,
     Text,
     FileInfo,
-    FileData
+    FileData,
+    RosterPage
 };
 
+// Number of message types, every type is below it
+constexpr int MessageTypeCount = RosterPage + 1;
+
+// Wire format of a header, the text format is kept for clients that do not speak the binary one
+enum class HeaderFormat
+{
+    Binary,
+    Text
+};
+
+// Byte offsets of the fields in a binary header, all integers are little-endian
+namespace HeaderLayout
+{
+    constexpr int StartByte = 0;
+    constexpr int Version = 1;
+    constexpr int Type = 2;
+    constexpr int DataSize = 3;
+    constexpr int TotalPacket = 7;
+    constexpr int No = 11;
+    constexpr int NameLength = 15;
+    constexpr int Name = 17;
+    constexpr int MaxNameLength = HEADER_SIZE - Name;
+}
+
+// Names of the message types in the text format, indexed by MessageType
+constexpr std::array<std::string_view, MessageTypeCount> MessageTypeNames = {
+    "Connection",
+    "Disconnection",
+    "Text",
+    "FileInfo",
+    "FileData",
+    "RosterPage"
+};
+
+// Get the name of a message type, unknown types have an empty name
+constexpr std::string_view messageTypeName(MessageType type)
+{
+    return type >= 0 && type < MessageTypeCount ? MessageTypeNames[type] : std::string_view();
+}
+
+// Get the message type with a name, unknown names are read as the first type like they always have been
+constexpr MessageType messageTypeFromName(std::string_view name)
+{
+    for(int i = 0; i < MessageTypeCount; i++)
+    {
+        if(MessageTypeNames[i] == name)
+        {
+            return MessageType(i);
+        }
+    }
+    return Connection;
+}
+
+// The header is plain data, it is copied with its bytes and holds its name in place
+// An empty name stands for the "null" placeholder of packets without a file name
 struct Header
 {
-private:
-    // Maps for converting MessageType to QString and vice versa
-    std::pmr::map<MessageType, QString> MessageTypeToString = {
-        {Connection, "Connection"},
-        {Disconnection, "Disconnection"},
-        {Text, "Text"},
-        {FileInfo, "FileInfo"},
-        {FileData, "FileData"}
-    };
-
-    std::pmr::map<QString, MessageType> StringToMessageType = {
-        {"Connection", Connection},
-        {"Disconnection", Disconnection},
-        {"Text", Text},
-        {"FileInfo", FileInfo},
-        {"FileData", FileData}
-    };
-
-public:
     MessageType type;
-    QString fileName;
     int dataSize;
     int totalPacket;
     int no;
+    HeaderFormat format;
+    quint16 nameLength;
+    char name[HeaderLayout::MaxNameLength];
 
     Header() {
         this->type = Text;
-        this->fileName = "null";
+        this->nameLength = 0;
         this->dataSize = 0;
         this->totalPacket = 0;
         this->no = 0;
+        this->format = HeaderFormat::Binary;
     }
 
     Header(MessageType type, int dataSize, int totalPacket, int no)
     {
         this->type = type;
-        this->fileName = "null";
+        this->nameLength = 0;
         this->dataSize = dataSize;
         this->totalPacket = totalPacket;
         this->no = no;
+        this->format = HeaderFormat::Binary;
     }
 
-    Header(MessageType type, QString fileName, int dataSize, int totalPacket, int no)
+    Header(MessageType type, const QString &fileName, int dataSize, int totalPacket, int no)
     {
         this->type = type;
-        this->fileName = fileName;
+        setFileName(fileName);
         this->dataSize = dataSize;
         this->totalPacket = totalPacket;
         this->no = no;
+        this->format = HeaderFormat::Binary;
     }
 
     Header(QByteArray headerData)
     {
-        QString headerDataStr = headerData;
-
-        // Parse header data
-        this->type = StringToMessageType[headerDataStr.split(",")[0].split(':')[1]];
-        this->fileName = headerDataStr.split(",")[1].split(':')[1];
-        this->dataSize = headerDataStr.split(",")[2].split(':')[1].toInt();
-        this->totalPacket = headerDataStr.split(",")[3].split(':')[1].toInt();
-        this->no = headerDataStr.split(",")[4].split(':')[1].split('\0')[0].toInt();
+        if(isBinary(headerData.constData(), headerData.size()))
+        {
+            decode(headerData.constData(), headerData.size());
+            return;
+        }
+
+        // Parse header data, the fields are "Key:Value" pairs separated by commas and padded with zeros
+        qsizetype end = headerData.indexOf('\0');
+        if(end >= 0)
+        {
+            headerData.truncate(end);
+        }
+
+        QList<QByteArray> fields = headerData.split(',');
+        auto value = [&fields](int i) {
+            return i < fields.size() ? fields[i].mid(fields[i].indexOf(':') + 1) : QByteArray();
+        };
+
+        QByteArray typeName = value(0);
+        this->type = messageTypeFromName(std::string_view(typeName.constData(), typeName.size()));
+        setFileName(QString::fromUtf8(value(1)));
+        this->dataSize = value(2).toInt();
+        this->totalPacket = value(3).toInt();
+        this->no = value(4).toInt();
+        this->format = HeaderFormat::Text;
+    }
+
+    // Get the file name, packets without one have the "null" placeholder
+    QString fileName() const
+    {
+        return nameLength > 0 ? QString::fromUtf8(name, nameLength) : QStringLiteral("null");
+    }
+
+    // Get the UTF-8 bytes of the file name in place, empty for packets without one
+    QByteArrayView fileNameView() const
+    {
+        return QByteArrayView(name, nameLength);
+    }
+
+    // Set the file name, names longer than the header has room for are cut
+    void setFileName(const QString &fileName)
+    {
+        nameLength = 0;
+        if(fileName == QLatin1String("null"))
+        {
+            return;
+        }
+
+        // UTF-8 needs at most 3 bytes per UTF-16 code unit, so short names are encoded in place
+        if(fileName.size() * 3 <= HeaderLayout::MaxNameLength)
+        {
+            QStringEncoder encoder(QStringEncoder::Utf8);
+            nameLength = encoder.appendToBuffer(name, fileName) - name;
+        }
+        else
+        {
+            // Cut the name on a character boundary, never inside the bytes of one character
+            QByteArray utf8Name = fileName.toUtf8();
+            qsizetype length = qMin<qsizetype>(utf8Name.size(), HeaderLayout::MaxNameLength);
+            while(length < utf8Name.size() && length > 0 && (quint8(utf8Name[length]) & 0xC0) == 0x80)
+            {
+                length--;
+            }
+            memcpy(name, utf8Name.constData(), length);
+            nameLength = length;
+        }
     }
 
-    QString toString()
+    // Check whether the raw header data is in the binary format
+    static bool isBinary(const char *src, qsizetype size)
     {
-        return "Type:" + MessageTypeToString[type] + ",Name:" + fileName + ",Size:" + QString::number(dataSize) + ",Packet:"
-               + QString::number(totalPacket) + ",No:" + QString::number(no) + "\0";
+        return size >= HeaderLayout::Name && src[HeaderLayout::StartByte] == START_BYTE
+               && quint8(src[HeaderLayout::Version]) == HEADER_VERSION;
     }
 
-    QByteArray toByteArray()
+    // Write the binary header into dst, which must hold at least HEADER_SIZE bytes
+    // Return the number of bytes used
+    int encode(char *dst) const
     {
+        dst[HeaderLayout::StartByte] = START_BYTE;
+        dst[HeaderLayout::Version] = char(HEADER_VERSION);
+        dst[HeaderLayout::Type] = char(type);
+        qToLittleEndian<qint32>(dataSize, dst + HeaderLayout::DataSize);
+        qToLittleEndian<qint32>(totalPacket, dst + HeaderLayout::TotalPacket);
+        qToLittleEndian<qint32>(no, dst + HeaderLayout::No);
+        qToLittleEndian<quint16>(nameLength, dst + HeaderLayout::NameLength);
+        memcpy(dst + HeaderLayout::Name, name, nameLength);
+
+        return HeaderLayout::Name + nameLength;
+    }
+
+    // Read the binary header from src, which must hold at least HeaderLayout::Name bytes
+    // Return the number of bytes consumed, or -1 if the message type is not one this version knows
+    int decode(const char *src, qsizetype size)
+    {
+        quint8 typeByte = quint8(src[HeaderLayout::Type]);
+        if(typeByte >= MessageTypeCount)
+        {
+            return -1;
+        }
+
+        this->type = MessageType(typeByte);
+        this->dataSize = qFromLittleEndian<qint32>(src + HeaderLayout::DataSize);
+        this->totalPacket = qFromLittleEndian<qint32>(src + HeaderLayout::TotalPacket);
+        this->no = qFromLittleEndian<qint32>(src + HeaderLayout::No);
+
+        qsizetype available = qMin<qsizetype>(size - HeaderLayout::Name, HeaderLayout::MaxNameLength);
+        this->nameLength = qMin<qsizetype>(qFromLittleEndian<quint16>(src + HeaderLayout::NameLength), available);
+        memcpy(name, src + HeaderLayout::Name, nameLength);
+
+        this->format = HeaderFormat::Binary;
+        return HeaderLayout::Name + nameLength;
+    }
+
+    QString toString() const
+    {
+        std::string_view typeName = messageTypeName(type);
+        return "Type:" + QString::fromLatin1(typeName.data(), typeName.size()) + ",Name:" + fileName() + ",Size:" + QString::number(dataSize)
+               + ",Packet:" + QString::number(totalPacket) + ",No:" + QString::number(no) + "\0";
+    }
+
+    QByteArray toByteArray(HeaderFormat format = HeaderFormat::Binary) const
+    {
+        if(format == HeaderFormat::Binary)
+        {
+            QByteArray headerData(HEADER_SIZE, Qt::Uninitialized);
+            headerData.resize(encode(headerData.data()));
+            return headerData;
+        }
+
+        // The text header is padded with zeros, the parser stops at the first one
         QByteArray headerData = toString().toUtf8();
         headerData.prepend(START_BYTE);
-        headerData.resize(HEADER_SIZE);
-        return headerData;
+        return headerData.leftJustified(HEADER_SIZE, '\0', true);
     }
 };
 
+// Headers are copied and pooled with their bytes
+static_assert(std::is_trivially_copyable_v<Header>, "Header must stay plain data");
+
 #endif // HEADER_H
@@ -2,12 +2,20 @@
 #include "ui_loginUI.h"
 #include "chatUI.h"
 
-Login::Login(QWidget *parent)
+Login::Login(int downloadStreams, QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::Login)
 {
     ui->setupUi(this);
     this->setWindowTitle("Login");
+    this->socket = nullptr;
+    this->downloadStreams = downloadStreams;
+
+    // Give up on a connection the server has not accepted in time
+    this->connectTimer = new QTimer(this);
+    connectTimer->setSingleShot(true);
+    connectTimer->setInterval(LOGIN_CONNECT_TIMEOUT);
+    connect(connectTimer, &QTimer::timeout, this, &Login::connectionFailed);
 
     // Connect the "connect" button to the login function
     connect(ui->connectButton, &QPushButton::clicked, this, &Login::on_action_loginButton_clicked);
@@ -15,38 +23,74 @@ Login::Login(QWidget *parent)
 
 Login::~Login()
 {
+    delete socket;
     delete ui;
 }
 
 void Login::on_action_loginButton_clicked()
 {
+    // A connection is already being opened
+    if(socket)
+    {
+        return;
+    }
+
     QString username = ui->usernameText->text();
+    QString host = ui->hostText->text().trimmed();
 
     // If username is empty, show an error message
     if(username.isEmpty())
     {
         QMessageBox::critical(this, "Error", "Username cannot be empty");
     }
+    else if(host.isEmpty())
+    {
+        QMessageBox::critical(this, "Error", "Server address cannot be empty");
+    }
     else
     {
-        // Create a new socket and connect to the server
-        QTcpSocket *socket = new QTcpSocket();
-        socket->connectToHost(QHostAddress::LocalHost, 1234);
-        socket->open(QIODevice::ReadWrite);
-
-        // If connection is successful, create a new chat window
-        if(socket->waitForConnected(3000))
-        {
-            Chat *chatWindow = new Chat(socket, username);
-            chatWindow->show();
-
-            // Close the login window
-            this->close();
-        }
-        // If connection is not successful, show an error message
-        else
-        {
-            QMessageBox::critical(this, "Error", "Could not connect to server");
-        }
+        this->username = username;
+
+        // Create a new socket and connect to the server, the window stays responsive until it answers
+        this->socket = new QTcpSocket();
+        connect(socket, &QTcpSocket::connected, this, &Login::openChat);
+        connect(socket, &QTcpSocket::errorOccurred, this, &Login::connectionFailed);
+        socket->connectToHost(host, ui->portSpinBox->value());
+
+        ui->connectButton->setEnabled(false);
+        connectTimer->start();
+    }
+}
+
+// If connection is successful, create a new chat window
+void Login::openChat()
+{
+    connectTimer->stop();
+
+    // The chat window takes the socket over
+    socket->disconnect(this);
+    Chat *chatWindow = new Chat(socket, username, downloadStreams);
+    chatWindow->show();
+    socket = nullptr;
+
+    // Close the login window
+    this->close();
+}
+
+// If connection is not successful, show an error message
+void Login::connectionFailed()
+{
+    if(!socket)
+    {
+        return;
     }
+
+    connectTimer->stop();
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+    socket = nullptr;
+
+    ui->connectButton->setEnabled(true);
+    QMessageBox::critical(this, "Error", "Could not connect to server");
 }
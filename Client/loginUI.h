@@ -5,6 +5,9 @@
 #include <QtNetwork>
 #include <QtWidgets>
 
+// Milliseconds given to the server to accept the connection before the login fails
+#define LOGIN_CONNECT_TIMEOUT 3000
+
 namespace Ui {
 class Login;
 }
@@ -14,14 +17,20 @@ class Login : public QWidget
     Q_OBJECT
 
 public:
-    explicit Login(QWidget *parent = nullptr);
+    explicit Login(int downloadStreams, QWidget *parent = nullptr);
     ~Login();
 
 private slots:
     void on_action_loginButton_clicked();
+    void openChat();
+    void connectionFailed();
 
 private:
     Ui::Login *ui;
+    QTcpSocket *socket;
+    QTimer *connectTimer;
+    QString username;
+    int downloadStreams;
 };
 
 #endif // LOGIN_H
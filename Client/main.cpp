@@ -1,11 +1,22 @@
 #include "loginUI.h"
+#include "tcp_manager.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    Login window;
+
+    // Large downloads can be split over several connections to the server
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption downloadStreamsOption("download-streams", "Number of connections a large download is split over.", "count",
+                                             QString::number(DEFAULT_DOWNLOAD_STREAMS));
+    parser.addOption(downloadStreamsOption);
+    parser.process(a);
+
+    Login window(parser.value(downloadStreamsOption).toInt());
     window.show();
     return a.exec();
 }
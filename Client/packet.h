@@ -3,36 +3,39 @@
 
 #include <QString>
 #include <QByteArray>
+#include <QByteArrayView>
+#include <QtEndian>
 
 #include "header.h"
 
 #define DATA_SIZE 1024
 #define TAIL_SIZE 4
 
+// Binary file data packets carry the CRC-32C of their data after it,
+// the last packet of a file also carries the SHA-256 of the whole file
+#define CHUNK_CHECKSUM_SIZE 4
+#define FILE_HASH_SIZE 32
+
 class Packet
 {
     public:
         Header header;
         QByteArray data;
 
+        // An empty packet, its data is only allocated once something is put in it
         Packet() {
             this->header = Header();
-            this->data = QByteArray(DATA_SIZE + TAIL_SIZE, 0);
         };
 
-        Packet(QByteArray rawData)
-        {
-            this->header = Header(rawData.left(HEADER_SIZE));
-            this->data = rawData.mid(HEADER_SIZE, this->header.dataSize);
-        };
+        Packet(QByteArrayView rawData);
 
-        Packet(Header header, QByteArray data)
+        Packet(const Header &header, QByteArray data)
         {
             this->header = header;
-            this->data = data;
+            this->data = std::move(data);
         };
 
-        Packet(Header header, QString message)
+        Packet(const Header &header, const QString &message)
         {
             this->header = header;
             this->data = message.toUtf8();
@@ -40,11 +43,22 @@ class Packet
 
         ~Packet() {};
 
-        QByteArray toByteArray()
+        QByteArray toByteArray(HeaderFormat format = HeaderFormat::Binary)
         {
+            // Binary packets are sized to the actual payload, the frame length is added by Frame::encode
+            if(format == HeaderFormat::Binary)
+            {
+                QByteArray rawData(HEADER_SIZE + this->data.size(), Qt::Uninitialized);
+                int headerSize = this->header.encode(rawData.data());
+                memcpy(rawData.data() + headerSize, this->data.constData(), this->data.size());
+                rawData.resize(headerSize + this->data.size());
+                return rawData;
+            }
+
+            // Text packets are padded to a fixed size for clients that read fixed-size frames
             // Create a raw data array and append the header to it
             QByteArray rawData;
-            rawData.append(this->header.toByteArray());
+            rawData.append(this->header.toByteArray(format));
 
             // If the data size is not equal to DATA_SIZE, resize the data array
             // Then append the data to the raw data array
@@ -63,4 +77,84 @@ class Packet
         };
 };
 
+// A packet read in place from a received frame, its data points into the frame instead of being copied out of it
+// It is only valid as long as the frame it was read from
+// Whatever follows the data of a binary packet is its tail, text packets have none
+// A packet with an unknown message type is not valid and has no data, it has to be dropped
+struct PacketView
+{
+    Header header;
+    QByteArrayView data;
+    QByteArrayView tail;
+    bool valid = true;
+
+    PacketView(QByteArrayView rawData)
+    {
+        // Binary headers are followed directly by the data, text headers are padded to HEADER_SIZE
+        qsizetype headerSize;
+        bool binary = Header::isBinary(rawData.data(), rawData.size());
+        if(binary)
+        {
+            headerSize = this->header.decode(rawData.data(), rawData.size());
+            if(headerSize < 0)
+            {
+                this->valid = false;
+                return;
+            }
+        }
+        else
+        {
+            headerSize = qMin<qsizetype>(HEADER_SIZE, rawData.size());
+            this->header = Header(rawData.first(headerSize).toByteArray());
+        }
+
+        qsizetype dataSize = qBound<qsizetype>(0, this->header.dataSize, rawData.size() - headerSize);
+        this->data = rawData.sliced(headerSize, dataSize);
+        if(binary)
+        {
+            this->tail = rawData.sliced(headerSize + dataSize);
+        }
+    }
+};
+
+// Size of the range carried by the data of a FileInfo request
+#define FILE_RANGE_SIZE 16
+
+// Part of a file asked for by a download, as a little-endian offset and length in bytes
+// A length of 0 asks for the rest of the file, a request without a range asks for all of it
+struct FileRange
+{
+    qint64 offset = 0;
+    qint64 length = 0;
+
+    // Read the range of a download request, data too short to hold one asks for the whole file
+    static FileRange fromData(QByteArrayView data)
+    {
+        FileRange range;
+        if(data.size() >= FILE_RANGE_SIZE)
+        {
+            range.offset = qMax<qint64>(qFromLittleEndian<qint64>(data.data()), 0);
+            range.length = qMax<qint64>(qFromLittleEndian<qint64>(data.data() + 8), 0);
+        }
+        return range;
+    }
+
+    // Write the range into the data of a download request
+    QByteArray toData() const
+    {
+        QByteArray data(FILE_RANGE_SIZE, Qt::Uninitialized);
+        qToLittleEndian<qint64>(offset, data.data());
+        qToLittleEndian<qint64>(length, data.data() + 8);
+        return data;
+    }
+};
+
+// Copy the data of a received packet out of its frame
+inline Packet::Packet(QByteArrayView rawData)
+{
+    PacketView view(rawData);
+    this->header = view.header;
+    this->data = view.data.toByteArray();
+}
+
 #endif // PACKET_H
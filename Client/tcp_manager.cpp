@@ -0,0 +1,636 @@
+#include "tcp_manager.h"
+
+#include <QDebug>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+
+TCPManager::TCPManager(QTcpSocket *socket, int downloadStreams)
+    : bufferPool(BUFFER_POOL_BUDGET)
+{
+    // The socket moves to the network thread along with this object
+    this->socket = socket;
+    socket->setParent(this);
+
+    // Keep where the socket is connected to, so that the connection can be opened again when it is lost
+    this->host = socket->peerName();
+    this->port = socket->peerPort();
+    this->reconnectDelay = INITIAL_RECONNECT_DELAY;
+    this->disconnected = false;
+    this->pendingBytes = 0;
+    this->lastDownload = nullptr;
+    this->downloadStreamCount = qBound(1, downloadStreams, MAX_DOWNLOAD_STREAMS);
+
+    this->reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer, &QTimer::timeout, this, &TCPManager::reconnect);
+
+    // The first page of the roster is sent by the server when logging in
+    this->rosterPageRequested = true;
+
+    // Events are handed to the UI in batches, at most once per interval
+    this->eventTimer = new QTimer(this);
+    eventTimer->setSingleShot(true);
+    eventTimer->setInterval(UI_BATCH_INTERVAL);
+    connect(eventTimer, &QTimer::timeout, this, &TCPManager::sendEvents);
+
+    // Connect the socket to the readDataFromSocket function
+    connect(socket, &QTcpSocket::readyRead, this, &TCPManager::readDataFromSocket);
+
+    // Send more file data packets whenever the socket has written some
+    connect(socket, &QTcpSocket::bytesWritten, this, &TCPManager::sendFileDataPacket);
+
+    // Follow the state of the connection instead of waiting on it
+    connect(socket, &QAbstractSocket::stateChanged, this, &TCPManager::socketStateChanged);
+    connect(socket, &QAbstractSocket::errorOccurred, this, &TCPManager::socketError);
+}
+
+TCPManager::~TCPManager()
+{
+    // Closing the socket here is not a lost connection, it is not opened again
+    socket->disconnect(this);
+    if(socket->isOpen())
+    {
+        socket->close();
+    }
+
+    // The streams write what they have received before the downloads keep their part files
+    foreach(DownloadStream *stream, downloadStreams)
+    {
+        stream->close();
+    }
+    qDeleteAll(downloadStreams);
+    qDeleteAll(uploads);
+    qDeleteAll(downloads);
+}
+
+// Send a message to the server
+void TCPManager::sendMessage(MessageType type, QByteArray message)
+{
+    // Encode the message straight into its frame
+    Header header(type, message.size(), 1, 1);
+    QByteArray frame = Frame::encode(header, message, HeaderFormat::Binary);
+
+    // The login is kept to log in again whenever the connection is opened again
+    if(type == MessageType::Connection)
+    {
+        loginFrame = frame;
+        if(isConnected())
+        {
+            socket->write(frame);
+        }
+    }
+    else
+    {
+        sendFrame(frame);
+    }
+
+    if(type == MessageType::Text)
+    {
+        addMessageEvent(type, QString(message));
+    }
+}
+
+// Send file data packets to the server until the socket's write buffer is full
+// Uploads wait while disconnected and carry on once the connection is back
+void TCPManager::sendFileDataPacket()
+{
+    if(!isConnected())
+    {
+        return;
+    }
+
+    // Check if there are packets to send and room for them in the write buffer
+    while(!uploads.isEmpty() && socket->bytesToWrite() < WRITE_BUFFER_LIMIT)
+    {
+        // Read the next chunk of the file being uploaded
+        TransferSession *upload = uploads.first();
+        Header header;
+        QByteArrayView tail;
+        QByteArrayView chunk = upload->nextChunk(&header, &tail);
+
+        // Encode it into the reused frame buffer along with its checksums, the socket copies it from there
+        Frame::encodeInto(frameBuffer, header, chunk, HeaderFormat::Binary, tail);
+        socket->write(frameBuffer.constData(), frameBuffer.size());
+
+        // Update the progress bar
+        setProgressEvent(header.no * 100 / header.totalPacket);
+
+        // Move on to the next file once the last packet is sent
+        if(upload->atEnd())
+        {
+            uploads.removeFirst();
+            delete upload;
+        }
+    }
+}
+
+// Request a file from the server, a part of it left by an earlier attempt is not downloaded again
+void TCPManager::requestFile(QString fileName)
+{
+    // A file already on its way is not asked for twice
+    if(downloads.contains(fileName))
+    {
+        return;
+    }
+
+    DownloadFile *download = new DownloadFile(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation) + "/" + fileName,
+                                              FILE_BUFFER_SIZE, &bufferPool);
+    if(!download->open())
+    {
+        qDebug() << "Could not open the download of" << fileName;
+        delete download;
+        return;
+    }
+    downloads.insert(fileName, download);
+
+    // While disconnected the request is made once the connection is back, along with the other downloads
+    if(isConnected())
+    {
+        requestDownload(fileName, download);
+    }
+}
+
+// Ask the server for the rest of a file over the chat connection
+// To split the download, only the next packet is asked for at first, it tells how large the file is
+void TCPManager::requestDownload(const QString &fileName, DownloadFile *download)
+{
+    if(downloadStreamCount > 1)
+    {
+        probingDownloads.insert(fileName);
+        requestRange(fileName, download->verifiedSize(), DATA_SIZE);
+    }
+    else
+    {
+        requestRange(fileName, download->verifiedSize(), 0);
+    }
+}
+
+// Ask the server for length bytes of a file from an offset, a length of 0 asks for the rest of the file
+void TCPManager::requestRange(const QString &fileName, qint64 offset, qint64 length)
+{
+    FileRange range;
+    range.offset = offset;
+    range.length = length;
+
+    Header header(MessageType::FileInfo, fileName, FILE_RANGE_SIZE, 1, 1);
+    socket->write(Frame::encode(header, range.toData(), HeaderFormat::Binary));
+}
+
+// Request the next page of the roster, unless one is on its way or the whole roster has been received
+// The roster is sent again from its first page after a reconnect, so no page is requested while disconnected
+void TCPManager::requestRosterPage()
+{
+    if(rosterPageRequested || rosterCursor.isEmpty() || !isConnected())
+    {
+        return;
+    }
+
+    // The cursor sent with the previous page tells the server where to continue
+    Header header(MessageType::RosterPage, rosterCursor, 0, 1, 1);
+    socket->write(Frame::encode(header, QByteArrayView(), HeaderFormat::Binary));
+
+    rosterPageRequested = true;
+}
+
+// Queue the files for upload, they are streamed from disk as the socket drains
+void TCPManager::readFiles(QStringList filePaths)
+{
+    // Queue an upload for each file, its packets are read from disk only as they are sent
+    foreach(QString filePath, filePaths)
+    {
+        uploads.append(new TransferSession(filePath, filePath.split('/').constLast(), READ_WINDOW_SIZE, &bufferPool));
+    }
+
+    // Start sending, the rest follows as the socket drains
+    sendFileDataPacket();
+}
+
+void TCPManager::readDataFromSocket()
+{
+    QByteArrayView frame;
+
+    // Buffer everything received, incomplete frames stay in the decoder until the rest arrives
+    frameDecoder.readFrom(socket);
+
+    // Handle every complete frame
+    while(frameDecoder.nextFrame(frame))
+    {
+        // Read the packet in place, its data is only copied where it goes
+        PacketView packet(frame);
+        if(!packet.valid)
+        {
+            qDebug() << "Dropping a packet of unknown type";
+            continue;
+        }
+        const Header &header = packet.header;
+        QByteArrayView data = packet.data;
+
+        // Handle the data based on the message type
+        switch (header.type) {
+        case MessageType::Text:
+        {
+            // Add the message to the chat dialog widget
+            addMessageEvent(header.type, QString::fromUtf8(data));
+            break;
+        }
+        case MessageType::Connection:
+        {
+            // Parse the list of clients
+            QByteArrayList clientList = data.toByteArray().split('\n');
+            clientList.pop_back();
+
+            // Add them to the client list widget and add messages to the chat dialog widget
+            foreach(QByteArray client, clientList)
+            {
+                addMessageEvent(header.type, client + " has joined the chat");
+                addClientEvent(client, true);
+            }
+            break;
+        }
+        case MessageType::RosterPage:
+        {
+            // Add the clients that were already in the chat to the client list widget
+            QByteArrayList clientList = data.toByteArray().split('\n');
+            clientList.pop_back();
+
+            foreach(QByteArray client, clientList)
+            {
+                addClientEvent(client, true);
+            }
+
+            // Keep the cursor of the next page, "null" means this was the last one
+            rosterCursor = header.nameLength == 0 ? QString() : header.fileName();
+            rosterPageRequested = false;
+            pendingEvents.rosterPageReceived = true;
+            scheduleEvents();
+            break;
+        }
+        case MessageType::Disconnection:
+        {
+            // The server sends the clients that left together, one name per line
+            QByteArrayList clientList = data.toByteArray().split('\n');
+
+            // Remove them from the client list widget and add messages to the chat dialog widget
+            foreach(QByteArray client, clientList)
+            {
+                addMessageEvent(header.type, client + " has left the chat");
+                addClientEvent(client, false);
+            }
+            break;
+        }
+        case MessageType::FileInfo:
+        {
+            // Add the file to the shared file list widget and add a message to the chat dialog widget
+            QString fileName = header.fileName();
+            addMessageEvent(header.type, QString::fromUtf8(data) + " has shared " + fileName);
+            addSharedFileEvent(fileName);
+            break;
+        }
+        case MessageType::FileData:
+        {
+            // Packets of the same file follow each other, so its download is only looked up when the file changes
+            DownloadFile *download = lastDownload;
+            if(!download || header.fileNameView() != lastDownloadName)
+            {
+                // Packets of a file that is not being downloaded are ignored
+                download = downloads.value(header.fileName());
+                if(!download)
+                {
+                    break;
+                }
+
+                lastDownload = download;
+                lastDownloadName = header.fileNameView().toByteArray();
+            }
+
+            // Packets are numbered from the start of the file, whatever range was asked for
+            qint64 offset = qint64(header.no - 1) * DATA_SIZE;
+            DownloadFile::WriteResult result = download->write(offset, data, packet.tail);
+            if(result == DownloadFile::WriteResult::Skipped)
+            {
+                break;
+            }
+
+            QString fileName = header.fileName();
+            if(result == DownloadFile::WriteResult::ChecksumError)
+            {
+                // Ask for the rest of the file again from the damaged packet, the packets already on their way are skipped
+                qDebug() << "Checksum error in packet" << header.no << "of" << fileName << ", downloading it again";
+                requestDownload(fileName, download);
+                break;
+            }
+
+            if(result == DownloadFile::WriteResult::DiskError || header.no == header.totalPacket)
+            {
+                downloads.remove(fileName);
+                probingDownloads.remove(fileName);
+                lastDownload = nullptr;
+
+                // The last packet carries the hash of the whole file, the file is only moved into place if it matches
+                QByteArrayView fileHash;
+                if(packet.tail.size() >= CHUNK_CHECKSUM_SIZE + FILE_HASH_SIZE)
+                {
+                    fileHash = packet.tail.sliced(CHUNK_CHECKSUM_SIZE, FILE_HASH_SIZE);
+                }
+                download->setFileEnd(offset + data.size(), fileHash);
+                bool finished = result == DownloadFile::WriteResult::Written && download->finish();
+                bool resumed = download->resumedFrom() > 0;
+                if(!finished)
+                {
+                    qDebug() << "Could not save" << fileName;
+                    delete download;
+
+                    // A part file left by an earlier attempt may be of an older file with the same name, start it over once
+                    if(result == DownloadFile::WriteResult::Written && resumed)
+                    {
+                        requestFile(fileName);
+                    }
+                    break;
+                }
+                logDownloadSpeed(fileName, download, 1);
+                delete download;
+            }
+            else if(probingDownloads.remove(fileName))
+            {
+                // The first packet tells how large the file is, the rest of it is split into ranges
+                startDownloadStreams(fileName, download, header.no, header.totalPacket);
+            }
+
+            // Update the file progress bar, only the latest progress of a batch is shown
+            setProgressEvent(header.no * 100 / header.totalPacket);
+
+            break;
+        }
+        default:
+            qDebug() << "Unknown message type " << header.type;
+            break;
+        }
+    }
+}
+
+// Check whether the connection to the server is open
+bool TCPManager::isConnected() const
+{
+    return socket->state() == QAbstractSocket::ConnectedState;
+}
+
+// Send a frame to the server, or keep it until the connection is back while disconnected
+void TCPManager::sendFrame(const QByteArray &frame)
+{
+    if(isConnected())
+    {
+        socket->write(frame);
+        return;
+    }
+
+    if(pendingBytes + frame.size() > PENDING_SEND_LIMIT)
+    {
+        qDebug() << "Dropping a message sent while disconnected, too much is waiting for the connection";
+        return;
+    }
+
+    pendingFrames.enqueue(frame);
+    pendingBytes += frame.size();
+}
+
+// Follow the connection as it is lost and opened again
+void TCPManager::socketStateChanged(QAbstractSocket::SocketState state)
+{
+    switch (state) {
+    case QAbstractSocket::ConnectedState:
+        connectionOpened();
+        break;
+    case QAbstractSocket::UnconnectedState:
+        connectionLost();
+        break;
+    default:
+        break;
+    }
+}
+
+void TCPManager::socketError(QAbstractSocket::SocketError error)
+{
+    qDebug() << "Connection error" << error << socket->errorString();
+}
+
+// Log in again and send everything kept while disconnected
+void TCPManager::connectionOpened()
+{
+    disconnected = false;
+    reconnectTimer->stop();
+    reconnectDelay = INITIAL_RECONNECT_DELAY;
+
+    // The server only knows this client once it has its name, so the login goes first
+    if(!loginFrame.isEmpty())
+    {
+        socket->write(loginFrame);
+    }
+
+    while(!pendingFrames.isEmpty())
+    {
+        socket->write(pendingFrames.dequeue());
+    }
+    pendingBytes = 0;
+
+    // Carry on with the downloads from the end of what has been received and checked
+    // Split downloads carry on by themselves over their own connections
+    for(auto it = downloads.cbegin(); it != downloads.cend(); ++it)
+    {
+        if(!hasDownloadStreams(it.value()))
+        {
+            requestDownload(it.key(), it.value());
+        }
+    }
+
+    // Carry on with the uploads
+    sendFileDataPacket();
+
+    emit connectionStateChanged(true);
+}
+
+// Drop what the server forgot along with the connection and try to open it again after the next delay
+void TCPManager::connectionLost()
+{
+    if(!disconnected)
+    {
+        disconnected = true;
+        frameDecoder = FrameDecoder();
+
+        // The server sends the roster again from its first page when logging in again
+        pendingEvents.clientChanges.clear();
+        pendingEvents.rosterReset = true;
+        rosterCursor.clear();
+        rosterPageRequested = true;
+        scheduleEvents();
+
+        // Uploads start over from their first packet, the server has thrown away what it received
+        foreach(TransferSession *upload, uploads)
+        {
+            upload->restart();
+        }
+
+        // Downloads keep what they have received, they carry on once the connection is back
+        probingDownloads.clear();
+
+        emit connectionStateChanged(false);
+    }
+
+    // Wait longer after every failed attempt, with some jitter so that clients do not all come back at once
+    int delay = reconnectDelay + QRandomGenerator::global()->bounded(reconnectDelay / 4 + 1);
+    reconnectDelay = qMin(reconnectDelay * 2, MAX_RECONNECT_DELAY);
+    reconnectTimer->start(delay);
+}
+
+// Open the connection to the server again, the state changes tell how it went
+void TCPManager::reconnect()
+{
+    qDebug() << "Reconnecting to" << host << port;
+    socket->connectToHost(host, port);
+}
+
+// Split the rest of a file into ranges of whole packets, each fetched over its own connection
+// The packets after packet no are spread evenly, the last range runs to the end of the file
+void TCPManager::startDownloadStreams(const QString &fileName, DownloadFile *download, int no, int totalPacket)
+{
+    qint64 remaining = totalPacket - no;
+    if(remaining * DATA_SIZE < PARALLEL_DOWNLOAD_MIN_SIZE || !download->preallocate(qint64(totalPacket - 1) * DATA_SIZE))
+    {
+        requestRange(fileName, download->verifiedSize(), 0);
+        return;
+    }
+
+    for(int i = 0; i < downloadStreamCount; i++)
+    {
+        qint64 offset = (no + remaining * i / downloadStreamCount) * DATA_SIZE;
+        qint64 end = i + 1 < downloadStreamCount ? (no + remaining * (i + 1) / downloadStreamCount) * DATA_SIZE : 0;
+
+        DownloadStream *stream = new DownloadStream(host, port, fileName, download, offset, end, &bufferPool, this);
+        connect(stream, &DownloadStream::progressed, this, &TCPManager::downloadStreamProgressed);
+        connect(stream, &DownloadStream::finished, this, &TCPManager::downloadStreamFinished);
+        downloadStreams.append(stream);
+    }
+}
+
+// Check whether a download is split over extra connections
+bool TCPManager::hasDownloadStreams(DownloadFile *download) const
+{
+    foreach(DownloadStream *stream, downloadStreams)
+    {
+        if(stream->file() == download)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Stop every range of a download, what they have received is written first
+void TCPManager::closeDownloadStreams(DownloadFile *download)
+{
+    for(int i = downloadStreams.size() - 1; i >= 0; i--)
+    {
+        DownloadStream *stream = downloadStreams[i];
+        if(stream->file() == download)
+        {
+            stream->close();
+            downloadStreams.removeAt(i);
+            stream->deleteLater();
+        }
+    }
+}
+
+// Update the file progress bar with the ranges received so far
+void TCPManager::downloadStreamProgressed(DownloadStream *stream)
+{
+    setProgressEvent(stream->file()->progress());
+}
+
+// Move a split download into place once its last range is complete, or give it up when a range cannot be written
+void TCPManager::downloadStreamFinished(DownloadStream *stream, bool written)
+{
+    DownloadFile *download = stream->file();
+    QString fileName = stream->fileName();
+    downloadStreams.removeOne(stream);
+    stream->deleteLater();
+
+    if(written && hasDownloadStreams(download))
+    {
+        return;
+    }
+
+    closeDownloadStreams(download);
+    downloads.remove(fileName);
+    if(lastDownload == download)
+    {
+        lastDownload = nullptr;
+    }
+
+    bool finished = written && download->isComplete() && download->finish();
+    if(!finished)
+    {
+        qDebug() << "Could not save" << fileName;
+        delete download;
+        return;
+    }
+    logDownloadSpeed(fileName, download, downloadStreamCount);
+    delete download;
+    setProgressEvent(100);
+}
+
+// Log how long a finished download took, to compare downloads split over different numbers of connections
+void TCPManager::logDownloadSpeed(const QString &fileName, DownloadFile *download, int numConnections)
+{
+    qint64 elapsed = qMax<qint64>(download->elapsed(), 1);
+    qDebug() << "Downloaded" << download->downloadedSize() << "bytes of" << fileName << "in" << elapsed << "ms over"
+             << numConnections << "connections," << download->downloadedSize() / (elapsed / 1e3) / 1e6 << "MB/s";
+}
+
+// Add a line for the chat dialog to the next batch of events
+void TCPManager::addMessageEvent(MessageType type, QString message)
+{
+    pendingEvents.messages.append(qMakePair(type, message));
+    scheduleEvents();
+}
+
+// Add a client joining or leaving to the next batch of events
+void TCPManager::addClientEvent(QString clientName, bool joined)
+{
+    pendingEvents.clientChanges.append(qMakePair(clientName, joined));
+    scheduleEvents();
+}
+
+// Add a shared file to the next batch of events
+void TCPManager::addSharedFileEvent(QString fileName)
+{
+    pendingEvents.sharedFiles.append(fileName);
+    scheduleEvents();
+}
+
+// Set the progress of the current transfer, it replaces the progress set earlier in the same batch
+void TCPManager::setProgressEvent(int progress)
+{
+    pendingEvents.progress = progress;
+    scheduleEvents();
+}
+
+// Start the batch interval unless it is already running
+void TCPManager::scheduleEvents()
+{
+    if(!eventTimer->isActive())
+    {
+        eventTimer->start();
+    }
+}
+
+// Hand the events collected during the batch interval to the UI
+void TCPManager::sendEvents()
+{
+    if(pendingEvents.isEmpty())
+    {
+        return;
+    }
+
+    ChatEvents events;
+    std::swap(events, pendingEvents);
+    emit eventsReceived(events);
+}
@@ -0,0 +1,143 @@
+#ifndef TCP_MANAGER_H
+#define TCP_MANAGER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
+
+#include "header.h"
+#include "packet.h"
+#include "frame.h"
+#include "transfer_session.h"
+#include "download_file.h"
+#include "download_stream.h"
+#include "buffer_pool.h"
+
+// Stop queueing file data once this many bytes are waiting in the socket's write buffer
+#define WRITE_BUFFER_LIMIT (256 * 1024)
+
+// Bytes of a file read from disk at a time while uploading it
+#define READ_WINDOW_SIZE DEFAULT_READ_WINDOW_SIZE
+
+// Bytes of a downloaded file collected before they are written to disk
+#define FILE_BUFFER_SIZE DEFAULT_FILE_BUFFER_SIZE
+
+// Connections a download is split over unless another number is given, 1 downloads over the chat connection alone
+#define DEFAULT_DOWNLOAD_STREAMS 1
+#define MAX_DOWNLOAD_STREAMS 16
+
+// Files smaller than this are downloaded over the chat connection even when downloads are split
+#define PARALLEL_DOWNLOAD_MIN_SIZE (4 * 1024 * 1024)
+
+// Bytes of file transfer buffers kept by the client, transfers beyond it go unbuffered
+#define BUFFER_POOL_BUDGET (16 * 1024 * 1024)
+
+// Delay in milliseconds before the first attempt to reconnect, it doubles after every failed attempt
+#define INITIAL_RECONNECT_DELAY 500
+
+// Longest delay in milliseconds between two attempts to reconnect
+#define MAX_RECONNECT_DELAY 30000
+
+// Bytes of messages kept while disconnected, they are sent once the connection is back
+#define PENDING_SEND_LIMIT (4 * 1024 * 1024)
+
+// Interval in milliseconds at which received events are handed to the UI, about once per frame
+#define UI_BATCH_INTERVAL 16
+
+// Events collected for the UI since the last batch, the UI handles them all at once
+struct ChatEvents
+{
+    QList<QPair<MessageType, QString>> messages;
+    QList<QPair<QString, bool>> clientChanges;
+    QStringList sharedFiles;
+    int progress = -1;
+    bool rosterPageReceived = false;
+    bool rosterReset = false;
+
+    bool isEmpty() const
+    {
+        return messages.isEmpty() && clientChanges.isEmpty() && sharedFiles.isEmpty() && progress < 0 && !rosterPageReceived
+               && !rosterReset;
+    }
+};
+
+// Connection to the server, it lives on its own network thread together with its socket
+// The socket I/O, file reads and packet parsing all run there, the UI only talks to it through queued signals
+// A lost connection is opened again in the background, what is sent meanwhile is kept until it is back
+// Large downloads can be split into ranges fetched side by side over extra connections
+class TCPManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    TCPManager(QTcpSocket *socket, int downloadStreams = DEFAULT_DOWNLOAD_STREAMS);
+    ~TCPManager();
+
+public slots:
+    void sendMessage(MessageType type, QByteArray message);
+    void readFiles(QStringList filePath);
+    void requestFile(QString fileName);
+    void requestRosterPage();
+
+signals:
+    void eventsReceived(ChatEvents events);
+    void connectionStateChanged(bool connected);
+
+private slots:
+    void readDataFromSocket();
+    void sendFileDataPacket();
+    void sendEvents();
+    void socketStateChanged(QAbstractSocket::SocketState state);
+    void socketError(QAbstractSocket::SocketError error);
+    void reconnect();
+    void downloadStreamProgressed(DownloadStream *stream);
+    void downloadStreamFinished(DownloadStream *stream, bool written);
+
+private:
+    bool isConnected() const;
+    void sendFrame(const QByteArray &frame);
+    void requestDownload(const QString &fileName, DownloadFile *download);
+    void requestRange(const QString &fileName, qint64 offset, qint64 length);
+    void startDownloadStreams(const QString &fileName, DownloadFile *download, int no, int totalPacket);
+    bool hasDownloadStreams(DownloadFile *download) const;
+    void closeDownloadStreams(DownloadFile *download);
+    void connectionOpened();
+    void connectionLost();
+    void addMessageEvent(MessageType type, QString message);
+    void addClientEvent(QString clientName, bool joined);
+    void addSharedFileEvent(QString fileName);
+    void setProgressEvent(int progress);
+    void logDownloadSpeed(const QString &fileName, DownloadFile *download, int numConnections);
+    void scheduleEvents();
+
+private:
+    QTcpSocket *socket;
+    QString host;
+    quint16 port;
+    QTimer *reconnectTimer;
+    int reconnectDelay;
+    bool disconnected;
+    QByteArray loginFrame;
+    QQueue<QByteArray> pendingFrames;
+    qint64 pendingBytes;
+    FrameDecoder frameDecoder;
+    BufferPool bufferPool;
+    QList<TransferSession *> uploads;
+    QHash<QString, DownloadFile *> downloads;
+    DownloadFile *lastDownload;
+    QByteArray lastDownloadName;
+    int downloadStreamCount;
+    QList<DownloadStream *> downloadStreams;
+    QSet<QString> probingDownloads;
+    QByteArray frameBuffer;
+    QString rosterCursor;
+    bool rosterPageRequested;
+    ChatEvents pendingEvents;
+    QTimer *eventTimer;
+};
+
+#endif // TCP_MANAGER_H
@@ -0,0 +1,129 @@
+#include "transfer_session.h"
+#include "crc32c.h"
+
+#include <QtEndian>
+
+TransferSession::TransferSession(QString filePath, QString fileName, qint64 windowSize, BufferPool *pool, FileRange range)
+    : file(filePath), hash(QCryptographicHash::Sha256)
+{
+    this->pool = pool;
+    this->windowOffset = 0;
+
+    // Keep the window a whole number of packets so that only the last packet of the file is short
+    this->windowSize = qMax<qint64>(windowSize / DATA_SIZE, 1) * DATA_SIZE;
+
+    // Without a buffer from the pool the window is a single packet, allocated outside the pool's budget
+    this->window = pool->acquire(this->windowSize);
+    this->pooledWindow = !window.isNull();
+    if(!pooledWindow)
+    {
+        this->windowSize = DATA_SIZE;
+    }
+
+    // A file that cannot be opened is sent as a single empty packet
+    qint64 fileSize = file.open(QIODevice::ReadOnly) ? file.size() : 0;
+
+    // Calculate the number of packets needed to send the file
+    this->totalPacket = fileSize / DATA_SIZE + 1;
+
+    // The range is widened to whole packets, a range past the end of the file still gets the last packet and its hash
+    this->firstPacket = qMin<qint64>(range.offset / DATA_SIZE, totalPacket - 1);
+    this->lastPacket = totalPacket;
+    if(range.length > 0)
+    {
+        qint64 end = range.offset + range.length;
+        this->lastPacket = qBound<qint64>(firstPacket + 1, (end + DATA_SIZE - 1) / DATA_SIZE, totalPacket);
+    }
+    this->no = firstPacket;
+
+    if(file.isOpen())
+    {
+        file.seek(qint64(firstPacket) * DATA_SIZE);
+    }
+
+    // Every packet of the file has the same header apart from its size and number
+    this->header = Header(MessageType::FileData, fileName, 0, totalPacket, 0);
+    this->tailBuffer.reserve(CHUNK_CHECKSUM_SIZE + FILE_HASH_SIZE);
+}
+
+TransferSession::~TransferSession()
+{
+    file.close();
+
+    // Only a window taken from the pool goes back to it, the pool never counted the others
+    if(pooledWindow)
+    {
+        pool->release(window);
+    }
+}
+
+// Check whether every packet of the range has been sent
+bool TransferSession::atEnd() const
+{
+    return no >= lastPacket;
+}
+
+// Get the name the file is sent under
+QString TransferSession::fileName() const
+{
+    return header.fileName();
+}
+
+// Use a hash of the whole file worked out earlier, a transfer from the start of the file hashes it as it goes
+void TransferSession::setFileHash(const QByteArray &fileHash)
+{
+    this->fileHash = fileHash;
+}
+
+// Take the next chunk of the file from the window, fill in its header and point tail at its checksums
+// The chunk and the tail stay valid until the next call
+QByteArrayView TransferSession::nextChunk(Header *header, QByteArrayView *tail)
+{
+    // Read the next window from disk once every chunk of the current one has been sent
+    if(windowOffset >= window.size() && file.isOpen())
+    {
+        window.resize(windowSize);
+        qint64 numBytes = file.read(window.data(), windowSize);
+        window.resize(qMax<qint64>(numBytes, 0));
+        windowOffset = 0;
+    }
+
+    QByteArrayView chunk = QByteArrayView(window).sliced(windowOffset, qMin<qsizetype>(DATA_SIZE, window.size() - windowOffset));
+    windowOffset += chunk.size();
+
+    // Only a transfer that has seen the file from its first byte can hash it
+    bool hashing = fileHash.isEmpty() && firstPacket == 0;
+    if(hashing)
+    {
+        hash.addData(chunk);
+    }
+
+    tailBuffer.resize(CHUNK_CHECKSUM_SIZE);
+    qToLittleEndian<quint32>(Crc32c::checksum(chunk), tailBuffer.data());
+
+    no++;
+    if(no == totalPacket && (hashing || fileHash.size() == FILE_HASH_SIZE))
+    {
+        tailBuffer.append(hashing ? hash.result() : fileHash);
+    }
+    *tail = tailBuffer;
+
+    this->header.dataSize = chunk.size();
+    this->header.no = no;
+    *header = this->header;
+    return chunk;
+}
+
+// Go back to the first packet of the range, for a transfer that has to be sent again from the start
+void TransferSession::restart()
+{
+    if(file.isOpen())
+    {
+        file.seek(qint64(firstPacket) * DATA_SIZE);
+    }
+
+    window.resize(0);
+    windowOffset = 0;
+    hash.reset();
+    no = firstPacket;
+}
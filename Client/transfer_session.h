@@ -0,0 +1,48 @@
+#ifndef TRANSFER_SESSION_H
+#define TRANSFER_SESSION_H
+
+#include <QString>
+#include <QFile>
+#include <QByteArrayView>
+#include <QCryptographicHash>
+
+#include "packet.h"
+#include "buffer_pool.h"
+
+// Default number of bytes read from disk at a time by a transfer
+#define DEFAULT_READ_WINDOW_SIZE (64 * 1024)
+
+// Transfer of one file to one peer, the file is read one window at a time as packets are sent
+// so the memory used stays bounded by the window size whatever the size of the file
+// The window is taken from a pool, once the pool's budget is used up the file is read one packet at a time
+// Packets are numbered from the start of the file, so a range starts at the packet holding its first byte
+// Every packet gets the CRC-32C of its data in its tail, the last packet of the file also gets the hash of the whole file
+class TransferSession
+{
+public:
+    TransferSession(QString filePath, QString fileName, qint64 windowSize, BufferPool *pool, FileRange range = FileRange());
+    ~TransferSession();
+    bool atEnd() const;
+    QString fileName() const;
+    void setFileHash(const QByteArray &fileHash);
+    QByteArrayView nextChunk(Header *header, QByteArrayView *tail);
+    void restart();
+
+private:
+    QFile file;
+    BufferPool *pool;
+    Header header;
+    QByteArray window;
+    bool pooledWindow;
+    qint64 windowSize;
+    qsizetype windowOffset;
+    QCryptographicHash hash;
+    QByteArray fileHash;
+    QByteArray tailBuffer;
+    int totalPacket;
+    int firstPacket;
+    int lastPacket;
+    int no;
+};
+
+#endif // TRANSFER_SESSION_H
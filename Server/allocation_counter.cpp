@@ -0,0 +1,45 @@
+#include "allocation_counter.h"
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+
+#include <atomic>
+#include <cstddef>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+static std::atomic<qint64> numAllocations(0);
+
+// Qt's containers and operator new all allocate through these, the process uses them instead of the ones of the C library
+extern "C" void *malloc(size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+qint64 AllocationCounter::count()
+{
+    return numAllocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+qint64 AllocationCounter::count()
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <QtGlobal>
+
+// Count of the heap allocations made by the whole process, for checking how many the packet paths make
+// Allocations are only counted when built with `qmake CONFIG+=count_allocations` against glibc
+namespace AllocationCounter
+{
+    // Number of allocations made so far, -1 if they are not counted
+    qint64 count();
+}
+
+#endif // ALLOCATION_COUNTER_H
@@ -0,0 +1,79 @@
+#include "buffer_pool.h"
+
+BufferPool::BufferPool(qint64 budget)
+{
+    this->budgetBytes = budget;
+    this->numUsedBytes = 0;
+    this->numFreeBytes = 0;
+}
+
+// Hand out an empty buffer with room for at least size bytes, the smallest free buffer large enough is reused
+// Return a null buffer if it does not fit in the budget
+QByteArray BufferPool::acquire(qint64 size)
+{
+    auto it = freeBuffers.lowerBound(size);
+    if(it != freeBuffers.end())
+    {
+        QByteArray buffer = it.value();
+        freeBuffers.erase(it);
+        numFreeBytes -= buffer.capacity();
+        numUsedBytes += buffer.capacity();
+        return buffer;
+    }
+
+    if(numUsedBytes + size > budgetBytes)
+    {
+        return QByteArray();
+    }
+
+    // Free buffers that are too small make room for the new one
+    while(numUsedBytes + numFreeBytes + size > budgetBytes && !freeBuffers.isEmpty())
+    {
+        numFreeBytes -= freeBuffers.first().capacity();
+        freeBuffers.erase(freeBuffers.begin());
+    }
+
+    QByteArray buffer;
+    buffer.reserve(size);
+    numUsedBytes += buffer.capacity();
+    return buffer;
+}
+
+// Take a buffer back once its transfer has ended, it is kept for the next one
+void BufferPool::release(QByteArray &buffer)
+{
+    if(buffer.isNull())
+    {
+        return;
+    }
+
+    qint64 capacity = buffer.capacity();
+    numUsedBytes -= capacity;
+
+    // A buffer still shared with a packet or the socket cannot be reused without copying it, it is freed along with them
+    if(buffer.isDetached() && numUsedBytes + numFreeBytes + capacity <= budgetBytes)
+    {
+        buffer.resize(0);
+        freeBuffers.insert(capacity, buffer);
+        numFreeBytes += capacity;
+    }
+
+    buffer = QByteArray();
+}
+
+qint64 BufferPool::budget() const
+{
+    return budgetBytes;
+}
+
+// Bytes of the buffers handed out
+qint64 BufferPool::usedBytes() const
+{
+    return numUsedBytes;
+}
+
+// Bytes of the buffers kept for reuse
+qint64 BufferPool::freeBytes() const
+{
+    return numFreeBytes;
+}
@@ -0,0 +1,31 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <QByteArray>
+#include <QMultiMap>
+
+// Default number of bytes of transfer buffers a pool keeps, whether handed out or waiting to be reused
+#define DEFAULT_BUFFER_POOL_BUDGET (64 * 1024 * 1024)
+
+// Buffers of file transfers, allocated when a transfer needs one and reused by the next transfer once it ends
+// The buffers handed out and kept for reuse never add up to more than the budget,
+// a transfer that finds the budget used up goes without a buffer
+// A pool is only used from one thread
+class BufferPool
+{
+public:
+    BufferPool(qint64 budget);
+    QByteArray acquire(qint64 size);
+    void release(QByteArray &buffer);
+    qint64 budget() const;
+    qint64 usedBytes() const;
+    qint64 freeBytes() const;
+
+private:
+    QMultiMap<qint64, QByteArray> freeBuffers;
+    qint64 budgetBytes;
+    qint64 numUsedBytes;
+    qint64 numFreeBytes;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,435 @@
+#include "client_connection.h"
+#include "server.h"
+#include "worker.h"
+#include "crc32c.h"
+
+#include <QDebug>
+#include <QHostAddress>
+#include <QtEndian>
+
+ClientConnection::ClientConnection(Server *server, Worker *worker)
+{
+    this->server = server;
+    this->worker = worker;
+    this->socket = new QTcpSocket(this);
+
+    // Reply in the text format until the client has sent its first packet
+    this->format = HeaderFormat::Text;
+
+    // The client gets roster updates once it has logged in and received the roster
+    this->rosterVersion = 0;
+
+    // Extra connections of a client fetching a range of a download never log in, they only get their file data
+    this->loggedIn = false;
+    this->downloadStream = false;
+
+    this->outboundQueueBytes = 0;
+    this->numDroppedMessages = 0;
+    this->numDroppedBytes = 0;
+    this->lastUpload = nullptr;
+}
+
+ClientConnection::~ClientConnection()
+{
+    qDeleteAll(downloads);
+    qDeleteAll(uploads);
+}
+
+// Take over an accepted socket and connect signals
+bool ClientConnection::open(qintptr socketDescriptor)
+{
+    if(!socket->setSocketDescriptor(socketDescriptor))
+    {
+        qDebug() << "Could not open client socket:" << socket->errorString();
+        return false;
+    }
+
+    connect(socket, &QTcpSocket::readyRead, this, &ClientConnection::readDataFromClient);
+    connect(socket, &QTcpSocket::disconnected, this, &ClientConnection::clientDisconnected);
+    connect(socket, &QTcpSocket::bytesWritten, this, &ClientConnection::sendQueuedData);
+
+    qDebug() << "Client connected at port " << socket->peerPort() << " with address " << socket->peerAddress().toString();
+
+    return true;
+}
+
+// Get the header format the client uses
+HeaderFormat ClientConnection::headerFormat() const
+{
+    return format;
+}
+
+// Check whether the client has logged in, only logged in clients get chat messages and roster updates
+bool ClientConnection::isLoggedIn() const
+{
+    return loggedIn;
+}
+
+// Check whether the connection only fetches a range of a download for a client logged in on another connection
+bool ClientConnection::isDownloadStream() const
+{
+    return downloadStream;
+}
+
+// Number of bytes waiting in the outbound queue
+qint64 ClientConnection::queuedBytes() const
+{
+    return outboundQueueBytes;
+}
+
+// Number of text messages dropped because the client fell behind
+qint64 ClientConnection::droppedMessages() const
+{
+    return numDroppedMessages;
+}
+
+// Number of bytes dropped because the client fell behind
+qint64 ClientConnection::droppedBytes() const
+{
+    return numDroppedBytes;
+}
+
+// Send a packet to the client in the header format it uses
+void ClientConnection::sendPacket(const Packet &packet)
+{
+    sendFrame(Frame::encode(packet, format), false);
+}
+
+// Queue an encoded frame for the client and write as much of the queue as the socket takes
+// Once the queue is full, droppable frames are dropped while the others are still queued
+// Return false once the client has been disconnected, nothing more is sent to it
+bool ClientConnection::sendFrame(const QByteArray &frame, bool droppable)
+{
+    if(!isConnected())
+    {
+        return false;
+    }
+
+    qint64 queueLimit = server->config().outboundQueueLimit;
+    if(outboundQueueBytes + frame.size() > queueLimit)
+    {
+        if(droppable)
+        {
+            dropFrame(frame);
+            return isConnected();
+        }
+
+        // Frames that cannot be dropped may go over the limit, but not without bound
+        if(outboundQueueBytes > queueLimit * HARD_QUEUE_LIMIT_FACTOR)
+        {
+            disconnectLaggard();
+            return false;
+        }
+    }
+
+    // A client that is behind gets its chat frames joined into larger buffers instead of one queue entry each
+    if(!outboundQueue.isEmpty() && outboundQueue.last().size() + frame.size() <= OUTBOUND_COALESCE_SIZE)
+    {
+        outboundQueue.last().append(frame);
+    }
+    else
+    {
+        outboundQueue.enqueue(frame);
+    }
+    outboundQueueBytes += frame.size();
+    sendQueuedData();
+    return true;
+}
+
+// Send the changes of a roster version to the client if it has logged in with an older version
+void ClientConnection::sendRosterUpdate(QList<EncodedPacket> &packets, quint64 version)
+{
+    if(rosterVersion == 0 || rosterVersion >= version)
+    {
+        return;
+    }
+
+    rosterVersion = version;
+    for(EncodedPacket &packet : packets)
+    {
+        if(!sendFrame(packet.frame(format), false))
+        {
+            return;
+        }
+    }
+}
+
+// Check whether the socket is still connected, a laggard's socket is closed from inside the send functions
+bool ClientConnection::isConnected() const
+{
+    return socket->state() == QAbstractSocket::ConnectedState;
+}
+
+// Count a dropped frame and disconnect the client if it has been behind for too long
+void ClientConnection::dropFrame(const QByteArray &frame)
+{
+    numDroppedMessages++;
+    numDroppedBytes += frame.size();
+
+    if(!laggingTimer.isValid())
+    {
+        laggingTimer.start();
+    }
+    else if(laggingTimer.elapsed() > server->config().laggardTimeout)
+    {
+        disconnectLaggard();
+    }
+}
+
+// Disconnect a client that does not keep up with the data sent to it
+void ClientConnection::disconnectLaggard()
+{
+    if(socket->state() == QAbstractSocket::ConnectedState)
+    {
+        qDebug() << "Disconnecting client at port" << socket->peerPort() << "after falling behind," << outboundQueueBytes << "bytes queued,"
+                 << numDroppedMessages << "messages dropped";
+        socket->abort();
+    }
+}
+
+// Write queued frames until the socket's write buffer is full, called again whenever it drains
+// File data is only sent once every queued frame has been written
+void ClientConnection::sendQueuedData()
+{
+    if(!isConnected())
+    {
+        return;
+    }
+
+    qint64 writeBufferLimit = server->config().writeBufferLimit;
+    while(!outboundQueue.isEmpty() && socket->bytesToWrite() < writeBufferLimit)
+    {
+        QByteArray frame = outboundQueue.dequeue();
+        outboundQueueBytes -= frame.size();
+        socket->write(frame);
+    }
+
+    // The client has caught up
+    if(outboundQueueBytes < server->config().outboundQueueLimit)
+    {
+        laggingTimer.invalidate();
+    }
+
+    if(outboundQueue.isEmpty())
+    {
+        sendFileDataPackets();
+    }
+}
+
+// Send file data packets until the socket's write buffer is full
+// Downloads take turns so that one large file does not hold back the others
+// Each chunk goes from the read window into one reused frame buffer, which the socket copies from
+void ClientConnection::sendFileDataPackets()
+{
+    qint64 writeBufferLimit = server->config().writeBufferLimit;
+    while(isConnected() && !downloads.isEmpty() && socket->bytesToWrite() < writeBufferLimit)
+    {
+        TransferSession *download = downloads.takeFirst();
+        Header header;
+        QByteArrayView tail;
+        QByteArrayView chunk = download->nextChunk(&header, &tail);
+        Frame::encodeInto(frameBuffer, header, chunk, format, tail);
+        socket->write(frameBuffer.constData(), frameBuffer.size());
+
+        // Move the download to the back of the queue, or drop it once the last packet is sent
+        if(download->atEnd())
+        {
+            delete download;
+        }
+        else
+        {
+            downloads.append(download);
+        }
+    }
+}
+
+// When the client disconnects
+void ClientConnection::clientDisconnected()
+{
+    // Stop handling the socket, it may still emit signals until this connection is deleted
+    socket->disconnect(this);
+
+    // Remove the client from the roster, the remaining clients hear about it with the next roster update
+    server->removeClient(this);
+
+    qDebug() << "Client disconnected at port " << socket->peerPort() << " with address " << socket->peerAddress().toString();
+
+    worker->removeConnection(this);
+}
+
+// Read data from the client
+void ClientConnection::readDataFromClient()
+{
+    QByteArrayView frame;
+    qint64 numPackets = 0;
+
+    // Buffer everything received, incomplete frames stay in the decoder until the rest arrives
+    frameDecoder.readFrom(socket);
+
+    // Handle every complete frame, until the client is disconnected for falling behind
+    while(isConnected() && frameDecoder.nextFrame(frame))
+    {
+        // Read the packet in place, its data is only copied where it goes: a forwarded frame or a file
+        PacketView packet(frame);
+        if(!packet.valid)
+        {
+            qDebug() << "Dropping a packet of unknown type";
+            continue;
+        }
+        const Header &header = packet.header;
+        QByteArrayView data = packet.data;
+        numPackets++;
+
+        // Reply to the client in the same header format it uses
+        format = header.format;
+
+        switch (header.type){
+            case MessageType::Text:
+            {
+                // Forward the message to all other clients
+                server->sendPacketToAllOtherClients(this, EncodedPacket(header, data));
+                break;
+            }
+            case MessageType::Connection:
+            {
+                // Add the client to the roster, the other clients hear about it with the next roster update
+                // Clients using the binary format page through the roster, the others get all of it at once
+                quint64 version;
+                QList<EncodedPacket> roster = server->joinRoster(this, data.toByteArray().split('\n')[0], format == HeaderFormat::Binary, &version);
+                loggedIn = true;
+                if(downloadStream)
+                {
+                    downloadStream = false;
+                    worker->reserve();
+                }
+
+                // Send the roster to the new client, the full roster is encoded once for all new clients
+                for(EncodedPacket &rosterPacket : roster)
+                {
+                    if(!sendFrame(rosterPacket.frame(format), false))
+                    {
+                        break;
+                    }
+                }
+                rosterVersion = qMax(rosterVersion, version);
+
+                break;
+            }
+            case MessageType::RosterPage:
+            {
+                // Send the next page of the roster, the client asks for it as the user scrolls through the list
+                sendPacket(server->rosterPage(header.fileName()));
+                break;
+            }
+            case MessageType::Disconnection:
+            {
+                // Handle the disconnection, this connection is deleted after this
+                worker->countPackets(numPackets);
+                clientDisconnected();
+                return;
+            }
+            case MessageType::FileData:
+            {
+                // Packets of the same file follow each other, so its writer is only looked up when the file changes
+                FileWriter *upload = lastUpload;
+                if(!upload || header.fileNameView() != lastUploadName)
+                {
+                    // Open a writer for the file on its first packet, it stays open until the last one
+                    // The rest of an upload that has been dropped is ignored
+                    QString fileName = header.fileName();
+                    upload = uploads.value(fileName);
+                    if(!upload && header.no != 1)
+                    {
+                        break;
+                    }
+                    if(!upload)
+                    {
+                        upload = new FileWriter(FILE_DIR + fileName, server->config().fileBufferSize, server->config().syncInterval,
+                                                worker->bufferPool());
+                        upload->open();
+                        uploads.insert(fileName, upload);
+                    }
+
+                    lastUpload = upload;
+                    lastUploadName = header.fileNameView().toByteArray();
+                }
+
+                // Drop an upload whose data has been damaged, its temporary file is discarded with its writer
+                // Clients that do not send checksums are trusted
+                if(packet.tail.size() >= CHUNK_CHECKSUM_SIZE && qFromLittleEndian<quint32>(packet.tail.data()) != Crc32c::checksum(data))
+                {
+                    qDebug() << "Dropping upload of" << header.fileName() << "after a checksum error in packet" << header.no;
+                    uploads.remove(header.fileName());
+                    lastUpload = nullptr;
+                    delete upload;
+                    break;
+                }
+
+                upload->write(data.constData(), data.size());
+
+                // Move the complete file into place and send file info to all clients if all packets have been received
+                if(header.no == header.totalPacket)
+                {
+                    QString fileName = header.fileName();
+                    uploads.remove(fileName);
+                    lastUpload = nullptr;
+
+                    // The last packet carries the hash of the whole file when the client sends one
+                    QByteArray fileHash = upload->fileHash();
+                    bool verified = packet.tail.size() < CHUNK_CHECKSUM_SIZE + FILE_HASH_SIZE
+                                    || packet.tail.sliced(CHUNK_CHECKSUM_SIZE, FILE_HASH_SIZE) == fileHash;
+                    bool committed = verified && upload->commit();
+                    delete upload;
+
+                    if(!committed)
+                    {
+                        qDebug() << "Could not save file" << fileName << (verified ? "" : "after a hash mismatch");
+                        break;
+                    }
+                    server->setFileHash(fileName, fileHash);
+
+                    QString senderName = server->clientName(this);
+                    QByteArray senderData = senderName.toUtf8();
+                    Header fileInfoHeader(MessageType::FileInfo, fileName, senderData.size(), 1, 1);
+
+                    server->sendPacketToAllClients(EncodedPacket(fileInfoHeader, senderData));
+                }
+
+                break;
+            }
+            case MessageType::FileInfo:
+            {
+                // Start a download of the file or of the range asked for, its packets are sent as the write buffer drains
+                // A new request for a file replaces the one still being sent, the client asks again after a failed check
+                // A connection asking for a file before logging in is a download stream, it does not count as a client
+                if(!loggedIn && !downloadStream)
+                {
+                    downloadStream = true;
+                    worker->countDownloadStream();
+                }
+                QString fileName = header.fileName();
+                for(int i = downloads.size() - 1; i >= 0; i--)
+                {
+                    if(downloads[i]->fileName() == fileName)
+                    {
+                        delete downloads.takeAt(i);
+                    }
+                }
+
+                TransferSession *download = new TransferSession(FILE_DIR + fileName, fileName, server->config().readWindowSize,
+                                                                worker->bufferPool(), FileRange::fromData(data));
+                download->setFileHash(server->fileHash(fileName));
+                downloads.append(download);
+                sendQueuedData();
+                break;
+            }
+            default:
+            {
+                qDebug() << "Unknown message type";
+                break;
+            }
+        }
+    }
+
+    worker->countPackets(numPackets);
+}
@@ -0,0 +1,77 @@
+#ifndef CLIENT_CONNECTION_H
+#define CLIENT_CONNECTION_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QQueue>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+
+#include "packet.h"
+#include "frame.h"
+#include "transfer_session.h"
+#include "file_writer.h"
+#include "roster.h"
+
+// Frames that cannot be dropped are queued up to this many times the outbound queue limit
+#define HARD_QUEUE_LIMIT_FACTOR 4
+
+// Frames queued behind each other are joined into buffers of up to this many bytes, so they go out in one write
+#define OUTBOUND_COALESCE_SIZE (16 * 1024)
+
+class Server;
+class Worker;
+
+// A connected client, it lives on the thread of the worker owning its socket
+class ClientConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    ClientConnection(Server *server, Worker *worker);
+    ~ClientConnection();
+    bool open(qintptr socketDescriptor);
+    HeaderFormat headerFormat() const;
+    bool isLoggedIn() const;
+    bool isDownloadStream() const;
+    qint64 queuedBytes() const;
+    qint64 droppedMessages() const;
+    qint64 droppedBytes() const;
+    void sendPacket(const Packet &packet);
+    bool sendFrame(const QByteArray &frame, bool droppable);
+    void sendRosterUpdate(QList<EncodedPacket> &packets, quint64 version);
+
+private:
+    bool isConnected() const;
+    void sendFileDataPackets();
+    void dropFrame(const QByteArray &frame);
+    void disconnectLaggard();
+
+private slots:
+    void sendQueuedData();
+    void readDataFromClient();
+    void clientDisconnected();
+
+private:
+    Server *server;
+    Worker *worker;
+    QTcpSocket *socket;
+    FrameDecoder frameDecoder;
+    HeaderFormat format;
+    quint64 rosterVersion;
+    bool loggedIn;
+    bool downloadStream;
+    QQueue<QByteArray> outboundQueue;
+    qint64 outboundQueueBytes;
+    qint64 numDroppedMessages;
+    qint64 numDroppedBytes;
+    QElapsedTimer laggingTimer;
+    QList<TransferSession *> downloads;
+    QHash<QString, FileWriter *> uploads;
+    FileWriter *lastUpload;
+    QByteArray lastUploadName;
+    QByteArray frameBuffer;
+};
+
+#endif // CLIENT_CONNECTION_H
@@ -0,0 +1,71 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QtGlobal>
+#include <QByteArrayView>
+#include <array>
+#include <cstring>
+
+// The SSE 4.2 instruction is used when the compiler targets it, e.g. with QMAKE_CXXFLAGS += -msse4.2
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE
+#endif
+
+// CRC-32C (Castagnoli) checksums of file chunks, they are checked end to end from disk to disk
+namespace Crc32c
+{
+    // Reflected Castagnoli polynomial
+    constexpr quint32 Polynomial = 0x82F63B78;
+
+    constexpr std::array<quint32, 256> makeTable()
+    {
+        std::array<quint32, 256> table = {};
+        for(quint32 i = 0; i < 256; i++)
+        {
+            quint32 crc = i;
+            for(int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ Polynomial : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    // CRC of every byte value, built at compile time
+    inline constexpr std::array<quint32, 256> Table = makeTable();
+
+    // Extend the checksum of the bytes before data with data, the checksum of no bytes is 0
+    inline quint32 update(quint32 crc, QByteArrayView data)
+    {
+        const uchar *bytes = reinterpret_cast<const uchar *>(data.data());
+        qsizetype size = data.size();
+        crc = ~crc;
+
+#ifdef CRC32C_HARDWARE
+        while(size >= 8)
+        {
+            quint64 word;
+            memcpy(&word, bytes, sizeof(word));
+            crc = quint32(_mm_crc32_u64(crc, word));
+            bytes += 8;
+            size -= 8;
+        }
+#endif
+
+        while(size-- > 0)
+        {
+            crc = Table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // Checksum of data
+    inline quint32 checksum(QByteArrayView data)
+    {
+        return update(0, data);
+    }
+}
+
+#endif // CRC32C_H
@@ -0,0 +1,101 @@
+#include "file_writer.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+// A sync interval of 0 leaves syncing to the commit of the file
+FileWriter::FileWriter(QString filePath, qint64 bufferSize, qint64 syncInterval, BufferPool *pool)
+    : file(filePath), hash(QCryptographicHash::Sha256)
+{
+    this->pool = pool;
+    this->bufferSize = bufferSize;
+    this->syncInterval = syncInterval;
+    this->unsyncedBytes = 0;
+}
+
+// A file that is not committed is discarded together with its temporary file
+FileWriter::~FileWriter()
+{
+    if(file.isOpen())
+    {
+        file.cancelWriting();
+    }
+
+    pool->release(buffer);
+}
+
+// Create the temporary file and the buffer
+bool FileWriter::open()
+{
+    buffer = pool->acquire(bufferSize);
+    if(buffer.isNull())
+    {
+        bufferSize = 0;
+    }
+
+    return file.open(QIODevice::WriteOnly);
+}
+
+// Collect data in the buffer and write it out once the buffer is full
+bool FileWriter::write(const char *data, qsizetype size)
+{
+    hash.addData(QByteArrayView(data, size));
+
+    if(buffer.size() + size > bufferSize && !flushBuffer())
+    {
+        return false;
+    }
+
+    // Data larger than the buffer is written directly
+    if(size >= bufferSize)
+    {
+        return file.write(data, size) == size;
+    }
+
+    buffer.append(data, size);
+    return true;
+}
+
+// Write the rest of the data and move the complete file into place
+bool FileWriter::commit()
+{
+    if(!flushBuffer())
+    {
+        file.cancelWriting();
+    }
+
+    return file.commit();
+}
+
+// Get the SHA-256 of everything written so far
+QByteArray FileWriter::fileHash() const
+{
+    return hash.result();
+}
+
+// Write the buffer to the file, syncing it to disk every syncInterval bytes
+bool FileWriter::flushBuffer()
+{
+    if(buffer.isEmpty())
+    {
+        return true;
+    }
+
+    // The bytes are copied out so that the buffer is kept for the next chunks rather than shared with the file
+    bool written = file.write(buffer.constData(), buffer.size()) == buffer.size();
+    unsyncedBytes += buffer.size();
+
+    buffer.resize(0);
+
+    if(syncInterval > 0 && unsyncedBytes >= syncInterval)
+    {
+        file.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(file.handle());
+#endif
+        unsyncedBytes = 0;
+    }
+
+    return written;
+}
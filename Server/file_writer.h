@@ -0,0 +1,40 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+#include "buffer_pool.h"
+
+// Default number of received bytes collected before they are written to disk
+#define DEFAULT_FILE_BUFFER_SIZE (64 * 1024)
+
+// Writer for one received file, it keeps the file open and writes the data in large chunks
+// The data goes to a temporary file that replaces the target file only once it is complete
+// The buffer is taken from a pool, once the pool's budget is used up the data is written as it comes
+// The data is hashed as it is written so the whole file can be checked without reading it back
+class FileWriter
+{
+public:
+    FileWriter(QString filePath, qint64 bufferSize, qint64 syncInterval, BufferPool *pool);
+    ~FileWriter();
+    bool open();
+    bool write(const char *data, qsizetype size);
+    bool commit();
+    QByteArray fileHash() const;
+
+private:
+    bool flushBuffer();
+
+    QSaveFile file;
+    QCryptographicHash hash;
+    BufferPool *pool;
+    QByteArray buffer;
+    qint64 bufferSize;
+    qint64 syncInterval;
+    qint64 unsyncedBytes;
+};
+
+#endif // FILE_WRITER_H
@@ -1,10 +1,83 @@
 #include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 
 #include "server.h"
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
-    Server server;
+
+    // Parse the command line options
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption workersOption({"w", "workers"}, "Number of worker threads handling client sockets.", "count",
+                                     QString::number(QThread::idealThreadCount()));
+    parser.addOption(workersOption);
+    QCommandLineOption writeBufferOption("write-buffer", "Bytes of file data queued per client socket before waiting for it to drain.",
+                                         "bytes", QString::number(DEFAULT_WRITE_BUFFER_LIMIT));
+    parser.addOption(writeBufferOption);
+    QCommandLineOption readWindowOption("read-window", "Bytes of a shared file read from disk at a time for each download.",
+                                        "bytes", QString::number(DEFAULT_READ_WINDOW_SIZE));
+    parser.addOption(readWindowOption);
+    QCommandLineOption fileBufferOption("file-buffer", "Bytes of an uploaded file collected before they are written to disk.",
+                                        "bytes", QString::number(DEFAULT_FILE_BUFFER_SIZE));
+    parser.addOption(fileBufferOption);
+    QCommandLineOption syncIntervalOption("sync-interval", "Sync uploaded files to disk every this many bytes, 0 only syncs complete files.",
+                                          "bytes", "0");
+    parser.addOption(syncIntervalOption);
+    QCommandLineOption bufferBudgetOption("buffer-budget", "Bytes of file transfer buffers kept by the server, transfers beyond it go unbuffered.",
+                                          "bytes", QString::number(DEFAULT_BUFFER_POOL_BUDGET));
+    parser.addOption(bufferBudgetOption);
+    QCommandLineOption queueLimitOption("queue-limit", "Bytes of messages queued per client before its text messages are dropped.",
+                                        "bytes", QString::number(DEFAULT_OUTBOUND_QUEUE_LIMIT));
+    parser.addOption(queueLimitOption);
+    QCommandLineOption laggardTimeoutOption("laggard-timeout", "Milliseconds a client may keep dropping messages before it is disconnected.",
+                                            "ms", QString::number(DEFAULT_LAGGARD_TIMEOUT));
+    parser.addOption(laggardTimeoutOption);
+    QCommandLineOption statsIntervalOption("stats-interval", "Log queue depth and drop counters every this many seconds, 0 disables it.",
+                                           "seconds", "0");
+    parser.addOption(statsIntervalOption);
+    QCommandLineOption addressOption({"a", "address"}, "Address the server listens on, \"any\" for all interfaces.", "address",
+                                     QHostAddress(QHostAddress::LocalHost).toString());
+    parser.addOption(addressOption);
+    QCommandLineOption portOption({"p", "port"}, "Port the server listens on.", "port", QString::number(DEFAULT_PORT));
+    parser.addOption(portOption);
+    QCommandLineOption reusePortOption("reuse-port", "Give every worker its own listening socket using SO_REUSEPORT (Linux only).");
+    parser.addOption(reusePortOption);
+    parser.process(a);
+
+    ServerConfig config;
+    config.numWorkers = qMax(parser.value(workersOption).toInt(), 1);
+    config.writeBufferLimit = qMax(parser.value(writeBufferOption).toLongLong(), qint64(DATA_SIZE));
+    config.readWindowSize = qMax(parser.value(readWindowOption).toLongLong(), qint64(DATA_SIZE));
+    config.fileBufferSize = qMax(parser.value(fileBufferOption).toLongLong(), qint64(DATA_SIZE));
+    config.syncInterval = qMax(parser.value(syncIntervalOption).toLongLong(), qint64(0));
+    config.bufferPoolBudget = qMax(parser.value(bufferBudgetOption).toLongLong(), qint64(0));
+    config.outboundQueueLimit = qMax(parser.value(queueLimitOption).toLongLong(), qint64(HEADER_SIZE + DATA_SIZE));
+    config.laggardTimeout = qMax(parser.value(laggardTimeoutOption).toLongLong(), qint64(0));
+    config.statsInterval = qMax(parser.value(statsIntervalOption).toInt(), 0);
+    config.reusePort = parser.isSet(reusePortOption);
+
+    QString address = parser.value(addressOption);
+    if(address.compare("any", Qt::CaseInsensitive) == 0)
+    {
+        config.listenAddress = QHostAddress(QHostAddress::Any);
+    }
+    else if(!config.listenAddress.setAddress(address))
+    {
+        qDebug() << "Invalid listen address" << address;
+        return 1;
+    }
+
+    bool validPort;
+    config.port = parser.value(portOption).toUShort(&validPort);
+    if(!validPort)
+    {
+        qDebug() << "Invalid port" << parser.value(portOption);
+        return 1;
+    }
+
+    Server server(config);
     return a.exec();
 }
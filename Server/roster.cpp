@@ -0,0 +1,280 @@
+#include "roster.h"
+
+Roster::Roster()
+{
+    this->rosterBytes = 0;
+    this->lastMemberNumber = 0;
+    this->publishScheduled = false;
+    this->version = 1;
+}
+
+// Log a client in, its name is sent to the other clients with the next publish
+// The current roster and its version are returned for the new client, paged clients only get its first page
+// Return true if a publish has to be scheduled
+bool Roster::join(ClientConnection *client, QString name, bool paged, QList<EncodedPacket> *roster, quint64 *version)
+{
+    QWriteLocker locker(&lock);
+
+    if(paged)
+    {
+        *roster = {EncodedPacket(pagePacket(0, lastMemberNumber))};
+    }
+    else
+    {
+        *roster = this->snapshot;
+    }
+    *version = this->version;
+
+    // A client logs in once, later logins are ignored
+    if(names.contains(client))
+    {
+        return false;
+    }
+
+    names.insert(client, name);
+    pendingJoins.append(qMakePair(client, name));
+
+    bool schedulePublish = !publishScheduled;
+    publishScheduled = true;
+    return schedulePublish;
+}
+
+// Log a client out and return its name, the other clients hear about it with the next publish
+QString Roster::leave(ClientConnection *client, bool *schedulePublish)
+{
+    QWriteLocker locker(&lock);
+    *schedulePublish = false;
+
+    if(!names.contains(client))
+    {
+        return QString();
+    }
+    QString name = names.take(client);
+
+    // A client whose join has not been published yet never shows up for the others
+    for(int i = 0; i < pendingJoins.size(); i++)
+    {
+        if(pendingJoins[i].first == client)
+        {
+            pendingJoins.removeAt(i);
+            return name;
+        }
+    }
+
+    // The page of the client is only changed by the next publish, like the other clients' view of the roster
+    pendingLeaveNumbers.append(memberNumbers.take(client));
+
+    // Take the client out of its chunk right away, the chunk is encoded again by the next publish
+    Chunk &chunk = chunks[chunkIndex.take(client)];
+    chunk.members.removeOne(client);
+    rosterBytes -= chunk.names.size();
+    chunk.names.clear();
+    foreach (ClientConnection *member, chunk.members) {
+        chunk.names.append(names.value(member).toUtf8()).append('\n');
+    }
+    rosterBytes += chunk.names.size();
+    chunk.dirty = true;
+
+    pendingLeaves.append(name.toUtf8());
+
+    *schedulePublish = !publishScheduled;
+    publishScheduled = true;
+    return name;
+}
+
+// Get the name a client has logged in with
+QString Roster::name(ClientConnection *client)
+{
+    QReadLocker locker(&lock);
+    return names.value(client);
+}
+
+// Get the page of the roster a cursor points at, the cursor of the next page is sent along with it
+Packet Roster::page(const QString &cursor)
+{
+    QReadLocker locker(&lock);
+
+    // The cursor holds the number of the last member sent and the last member of the roster the client started with
+    QStringList fields = cursor.split('.');
+    bool validAfter = false;
+    bool validLast = false;
+    if(fields.size() == 2)
+    {
+        quint64 after = fields[0].toULongLong(&validAfter);
+        quint64 last = fields[1].toULongLong(&validLast);
+        if(validAfter && validLast)
+        {
+            return pagePacket(after, last);
+        }
+    }
+
+    return pagePacket(0, 0);
+}
+
+// Make the page of the names of the members numbered after "after" up to "last"
+// Later members are left out, the client has heard about them through roster updates
+Packet Roster::pagePacket(quint64 after, quint64 last) const
+{
+    QByteArray data;
+    auto it = members.upperBound(after);
+    while(it != members.cend() && it.key() <= last)
+    {
+        if(!data.isEmpty() && data.size() + it.value().size() + 1 > DATA_SIZE)
+        {
+            break;
+        }
+        data.append(it.value()).append('\n');
+        after = it.key();
+        ++it;
+    }
+
+    // "null" marks the last page
+    QString nextCursor = "null";
+    if(it != members.cend() && it.key() <= last)
+    {
+        nextCursor = QString::number(after) + '.' + QString::number(last);
+    }
+
+    Header header(MessageType::RosterPage, nextCursor, data.size(), 1, 1);
+    return Packet(header, data);
+}
+
+// Apply the collected joins and leaves and make them the next version of the roster
+// Return the packets telling the clients about the changes
+Roster::Update Roster::publish()
+{
+    QWriteLocker locker(&lock);
+    publishScheduled = false;
+
+    Update update;
+    if(pendingJoins.isEmpty() && pendingLeaves.isEmpty())
+    {
+        return update;
+    }
+
+    foreach (quint64 memberNumber, pendingLeaveNumbers) {
+        members.remove(memberNumber);
+    }
+
+    // Members are numbered in the order they joined, pages list them in that order
+    QByteArrayList joinedNames;
+    for(const QPair<ClientConnection *, QString> &join : pendingJoins)
+    {
+        QByteArray name = join.second.toUtf8();
+        addToChunk(join.first, name + '\n');
+        joinedNames.append(name);
+
+        members.insert(++lastMemberNumber, name);
+        memberNumbers.insert(join.first, lastMemberNumber);
+    }
+
+    // Chunks emptied by leaves are only reused once they are compacted
+    while(!chunks.isEmpty() && chunks.last().members.isEmpty())
+    {
+        chunks.removeLast();
+        chunkPackets.removeLast();
+    }
+    if(chunks.size() > 2 * (rosterBytes / DATA_SIZE + 1))
+    {
+        rebuildChunks();
+    }
+
+    // Encode the changed chunks again, the others keep their packets
+    snapshot.clear();
+    for(int i = 0; i < chunks.size(); i++)
+    {
+        if(chunks[i].dirty)
+        {
+            chunkPackets[i] = encodeNames(chunks[i].names, MessageType::Connection);
+            chunkPackets[i].frame(HeaderFormat::Text);
+            chunks[i].dirty = false;
+        }
+
+        if(!chunks[i].members.isEmpty())
+        {
+            snapshot.append(chunkPackets[i]);
+        }
+    }
+
+    update.version = ++version;
+    update.packets = packNames(joinedNames, MessageType::Connection);
+    update.textPackets = update.packets;
+    update.packets.append(packNames(pendingLeaves, MessageType::Disconnection));
+    foreach (const QByteArray &name, pendingLeaves) {
+        update.textPackets.append(encodeNames(name + '\n', MessageType::Disconnection));
+    }
+
+    pendingJoins.clear();
+    pendingLeaves.clear();
+    pendingLeaveNumbers.clear();
+    return update;
+}
+
+// Add a name to the last chunk, starting a new one when it is full
+void Roster::addToChunk(ClientConnection *client, const QByteArray &line)
+{
+    if(chunks.isEmpty() || (!chunks.last().names.isEmpty() && chunks.last().names.size() + line.size() > DATA_SIZE))
+    {
+        chunks.append(Chunk());
+        chunkPackets.append(encodeNames(QByteArray(), MessageType::Connection));
+    }
+
+    Chunk &chunk = chunks.last();
+    chunk.members.append(client);
+    chunk.names.append(line);
+    chunk.dirty = true;
+
+    chunkIndex.insert(client, chunks.size() - 1);
+    rosterBytes += line.size();
+}
+
+// Pack the names into full chunks again once leaves have left too many of them half empty
+void Roster::rebuildChunks()
+{
+    QList<Chunk> oldChunks = chunks;
+    chunks.clear();
+    chunkPackets.clear();
+    chunkIndex.clear();
+    rosterBytes = 0;
+
+    foreach (const Chunk &chunk, oldChunks) {
+        foreach (ClientConnection *member, chunk.members) {
+            addToChunk(member, names.value(member).toUtf8() + '\n');
+        }
+    }
+}
+
+// Pack names into as few packets of at most DATA_SIZE bytes as possible
+QList<EncodedPacket> Roster::packNames(const QByteArrayList &names, MessageType type)
+{
+    QList<EncodedPacket> packets;
+    QByteArray data;
+
+    foreach (const QByteArray &name, names) {
+        if(!data.isEmpty() && data.size() + name.size() + 1 > DATA_SIZE)
+        {
+            packets.append(encodeNames(data, type));
+            data.clear();
+        }
+        data.append(name).append('\n');
+    }
+
+    if(!data.isEmpty())
+    {
+        packets.append(encodeNames(data, type));
+    }
+    return packets;
+}
+
+// Encode newline-terminated names into a packet
+// Disconnection packets have no newline after the last name, like when they only carried one name
+EncodedPacket Roster::encodeNames(QByteArray data, MessageType type)
+{
+    if(type == MessageType::Disconnection)
+    {
+        data.chop(1);
+    }
+
+    Header header(type, data.size(), 1, 1);
+    return EncodedPacket(header, data);
+}
@@ -0,0 +1,75 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QReadWriteLock>
+
+#include "packet.h"
+#include "frame.h"
+
+// Interval in milliseconds over which joins and leaves are collected into one roster update
+#define ROSTER_BATCH_INTERVAL 50
+
+class ClientConnection;
+
+// Names of the logged in clients, kept as ready to send Connection packets of at most DATA_SIZE bytes each
+// Joins and leaves are collected and published together, every publish makes a new version of the roster
+// Clients using the binary header format fetch the roster one page at a time instead, in the order the names joined
+// All functions are safe to call from any thread
+class Roster
+{
+public:
+    // Changes made by a publish, sent to the clients that have an older version of the roster
+    // Clients using the text header format read a Disconnection packet as one name, they get one packet per name
+    struct Update
+    {
+        quint64 version = 0;
+        QList<EncodedPacket> packets;
+        QList<EncodedPacket> textPackets;
+    };
+
+    Roster();
+    bool join(ClientConnection *client, QString name, bool paged, QList<EncodedPacket> *roster, quint64 *version);
+    QString leave(ClientConnection *client, bool *schedulePublish);
+    QString name(ClientConnection *client);
+    Packet page(const QString &cursor);
+    Update publish();
+
+private:
+    // A run of names sent together in one Connection packet
+    struct Chunk
+    {
+        QList<ClientConnection *> members;
+        QByteArray names;
+        bool dirty = true;
+    };
+
+    void addToChunk(ClientConnection *client, const QByteArray &line);
+    void rebuildChunks();
+    Packet pagePacket(quint64 after, quint64 last) const;
+    static QList<EncodedPacket> packNames(const QByteArrayList &names, MessageType type);
+    static EncodedPacket encodeNames(QByteArray data, MessageType type);
+
+    QReadWriteLock lock;
+    QHash<ClientConnection *, QString> names;
+    QHash<ClientConnection *, int> chunkIndex;
+    QList<Chunk> chunks;
+    QList<EncodedPacket> chunkPackets;
+    QList<EncodedPacket> snapshot;
+    QMap<quint64, QByteArray> members;
+    QHash<ClientConnection *, quint64> memberNumbers;
+    quint64 lastMemberNumber;
+    QList<quint64> pendingLeaveNumbers;
+    qsizetype rosterBytes;
+    QList<QPair<ClientConnection *, QString>> pendingJoins;
+    QByteArrayList pendingLeaves;
+    bool publishScheduled;
+    quint64 version;
+};
+
+#endif // ROSTER_H
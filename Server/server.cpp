@@ -1,21 +1,47 @@
 #include "server.h"
 #include "header.h"
+#include "worker.h"
+#include "allocation_counter.h"
 
-Server::Server() {
-    this->server = new QTcpServer();
+#include <QDebug>
+#include <QDir>
+#include <QFile>
 
-    // Initialize the file data packets buffer
-    this->fileDataPackets = new Packet[PACKET_BUFFER_SIZE];
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
-    // Initialize the two pointers for the file data packets buffer
-    this->endFileDataPacketIndex = 0;
-    this->currentFileDataPacketIndex = 0;
+// Resident memory of the process in bytes, -1 where it cannot be read
+static qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if(statm.open(QIODevice::ReadOnly))
+    {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if(fields.size() > 1)
+        {
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
 
-    // Create a timer to send the file data packets to the clients
-    this->timer = new QTimer(this);
-    timer->setInterval(5);
-    connect(timer, &QTimer::timeout, this, &Server::sendFileDataPacket);
-    timer->start();
+Server::Server(ServerConfig config) {
+    this->server = new Listener(this);
+    this->serverConfig = config;
+    this->statsTimer = nullptr;
+    this->lastAllocationCount = AllocationCounter::count();
+    this->lastPacketCount = 0;
+
+    // Joins and leaves are published together once the batch interval has passed
+    this->rosterTimer = new QTimer(this);
+    rosterTimer->setSingleShot(true);
+    rosterTimer->setInterval(ROSTER_BATCH_INTERVAL);
+    connect(rosterTimer, &QTimer::timeout, this, &Server::publishRoster);
 
     // Clear the file directory when the server starts
     QDir dir(FILE_DIR);
@@ -31,19 +57,56 @@ Server::Server() {
         }
     }
 
-    // Start the server
-    if(!server->listen(QHostAddress::LocalHost, 1234))
+    // Start the worker threads, each one runs its own event loop for the client sockets it owns
+    for(int i = 0; i < serverConfig.numWorkers; i++)
     {
-        qDebug() << "Could not start server";
+        QThread *thread = new QThread(this);
+        Worker *worker = new Worker(this);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+
+        workerThreads.append(thread);
+        workers.append(worker);
+    }
+
+    // Log the outbound queues of the clients regularly if asked to
+    if(serverConfig.statsInterval > 0)
+    {
+        this->statsTimer = new QTimer(this);
+        statsTimer->setInterval(serverConfig.statsInterval * 1000);
+        connect(statsTimer, &QTimer::timeout, this, &Server::logStats);
+        statsTimer->start();
+    }
+
+    server->setListenBacklogSize(LISTEN_BACKLOG);
+
+    // Start the server, either with one listening socket per worker or with a single one handing out the connections
+    if(serverConfig.reusePort && startReusePortListeners())
+    {
+        qDebug() << "Server started on" << serverConfig.listenAddress.toString() << "port" << serverConfig.port << "with"
+                 << serverConfig.numWorkers << "worker threads, each accepting its own connections";
+    }
+    else if(!server->listen(serverConfig.listenAddress, serverConfig.port))
+    {
+        qDebug() << "Could not start server:" << server->errorString();
     }
     else
     {
-        connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
-        qDebug() << "Server started";
+        connect(server, &Listener::newDescriptor, this, &Server::newConnection);
+        qDebug() << "Server started on" << serverConfig.listenAddress.toString() << "port" << serverConfig.port << "with"
+                 << serverConfig.numWorkers << "worker threads";
     }
 }
 
 Server::~Server() {
+    // Stop the worker threads
+    foreach(QThread *thread, workerThreads)
+    {
+        thread->quit();
+        thread->wait();
+    }
+
     // Clear the file directory when the server stops
     QDir dir(FILE_DIR);
     if(dir.exists())
@@ -57,235 +120,246 @@ Server::~Server() {
     qDebug() << "Server destroyed";
 }
 
-// Add new clients to the server and connect signals
-void Server::addNewClients(QTcpSocket *client) {
-    clients.append(client);
-    connect(client, &QTcpSocket::readyRead, this, &Server::readDataFromClient);
-    connect(client, &QTcpSocket::disconnected, this, &Server::clientDisconnected);
-    qDebug() << "Client connected at port " << client->peerPort() << " with address " << client->peerAddress().toString();
+// Let every worker accept connections on its own socket bound to the same port
+// The kernel spreads the incoming connections over the sockets, so accepting is not limited to one thread
+bool Server::startReusePortListeners() {
+    QList<qintptr> socketDescriptors;
+    foreach (Worker *worker, workers) {
+        qintptr socketDescriptor = Listener::openReusePortSocket(serverConfig.listenAddress, serverConfig.port);
+        if(socketDescriptor < 0)
+        {
+            // Fall back to a single listening socket
+            qDebug() << "Could not open a listening socket with SO_REUSEPORT, using a single one";
+            foreach (qintptr openedDescriptor, socketDescriptors) {
+#ifdef Q_OS_LINUX
+                ::close(int(openedDescriptor));
+#endif
+            }
+            return false;
+        }
+        socketDescriptors.append(socketDescriptor);
+    }
+
+    for(int i = 0; i < workers.size(); i++)
+    {
+        Worker *worker = workers[i];
+        qintptr socketDescriptor = socketDescriptors[i];
+        QMetaObject::invokeMethod(worker, [worker, socketDescriptor]() {
+            worker->listen(socketDescriptor);
+        }, Qt::QueuedConnection);
+    }
+    return true;
 }
 
-// Send file to the client who requested it
-void Server::readFile(QString fileName) {
-    QByteArray fileData;
+// Open a listening socket that shares its port with the other sockets opened by this function
+// Return -1 if the platform does not balance connections over such sockets or the socket could not be opened
+qintptr Listener::openReusePortSocket(const QHostAddress &address, quint16 port) {
+#ifdef Q_OS_LINUX
+    sockaddr_storage socketAddress = {};
+    socklen_t socketAddressLength;
+    bool ipv6 = address.protocol() != QAbstractSocket::IPv4Protocol;
+    if(ipv6)
+    {
+        sockaddr_in6 *address6 = reinterpret_cast<sockaddr_in6 *>(&socketAddress);
+        address6->sin6_family = AF_INET6;
+        address6->sin6_port = htons(port);
+        Q_IPV6ADDR ip = address == QHostAddress::Any ? QHostAddress(QHostAddress::AnyIPv6).toIPv6Address() : address.toIPv6Address();
+        memcpy(&address6->sin6_addr, &ip, sizeof(ip));
+        address6->sin6_scope_id = address.scopeId().toUInt();
+        socketAddressLength = sizeof(sockaddr_in6);
+    }
+    else
+    {
+        sockaddr_in *address4 = reinterpret_cast<sockaddr_in *>(&socketAddress);
+        address4->sin_family = AF_INET;
+        address4->sin_port = htons(port);
+        address4->sin_addr.s_addr = htonl(address.toIPv4Address());
+        socketAddressLength = sizeof(sockaddr_in);
+    }
 
-    // Open the file and read the data
-    QFile file(FILE_DIR + fileName);
-    if(file.open(QIODevice::ReadOnly))
+    int socketDescriptor = ::socket(ipv6 ? AF_INET6 : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(socketDescriptor < 0)
     {
-        fileData = file.readAll();
-        file.close();
+        return -1;
     }
 
-    // Calculate the number of packets needed to send the file
-    int numOfPackets = fileData.length() / DATA_SIZE + 1;
+    int enable = 1;
+    int disable = 0;
+    bool ok = ::setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == 0
+              && ::setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0;
 
-    // Create each packet push it to the file data packets buffer
-    for(int i = 0; i < numOfPackets; i++)
+    // QHostAddress::Any accepts both IPv4 and IPv6 connections
+    if(ok && ipv6 && address == QHostAddress::Any)
     {
-        QByteArray rawData = fileData.mid(i * DATA_SIZE, DATA_SIZE);
-        Header header(MessageType::FileData, fileName, rawData.size(), numOfPackets, i + 1);
-        Packet packet(header, rawData);
+        ok = ::setsockopt(socketDescriptor, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable)) == 0;
+    }
 
-        // Increment the end file data packet index after inserting the packet
-        fileDataPackets[endFileDataPacketIndex] = packet;
-        endFileDataPacketIndex = (endFileDataPacketIndex + 1) % PACKET_BUFFER_SIZE;
+    ok = ok && ::bind(socketDescriptor, reinterpret_cast<sockaddr *>(&socketAddress), socketAddressLength) == 0
+         && ::listen(socketDescriptor, LISTEN_BACKLOG) == 0;
+    if(!ok)
+    {
+        ::close(socketDescriptor);
+        return -1;
     }
-}
 
-// Send a packet to all clients
-void Server::sendPacketToAllClients(Packet packet) {
-    foreach (QTcpSocket* forwardClient, clients) {
-        // Lock the mutex
-        mutex.lock();
+    return socketDescriptor;
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    return -1;
+#endif
+}
 
-        QDataStream forwardStream(forwardClient);
-        forwardStream.setVersion(QDataStream::Qt_6_7);
-        forwardStream << packet.toByteArray();
+// Get the settings of the server, safe to call from any thread
+const ServerConfig &Server::config() const {
+    return serverConfig;
+}
 
-        // Unlock the mutex
-        mutex.unlock();
+// Log a client in with its name and get the roster packets to send it along with their version
+// Paged clients only get the first page of the roster and fetch the rest when they need it
+QList<EncodedPacket> Server::joinRoster(ClientConnection *client, QString clientName, bool paged, quint64 *rosterVersion) {
+    QList<EncodedPacket> rosterPackets;
+    if(roster.join(client, clientName, paged, &rosterPackets, rosterVersion))
+    {
+        QMetaObject::invokeMethod(this, &Server::scheduleRosterPublish, Qt::QueuedConnection);
     }
+    return rosterPackets;
 }
 
-// Send a packet to all clients except the one that sent the packet
-void Server::sendPacketToAllOtherClients(QTcpSocket *currentClient, Packet packet) {
-    foreach (QTcpSocket* forwardClient, clients) {
-        if(forwardClient != currentClient)
-        {
-            // Lock the mutex
-            mutex.lock();
-
-            QDataStream forwardStream(forwardClient);
-            forwardStream.setVersion(QDataStream::Qt_6_7);
-            forwardStream << packet.toByteArray();
+// Get the page of the roster a client's cursor points at
+Packet Server::rosterPage(const QString &cursor) {
+    return roster.page(cursor);
+}
 
-            // Unlock the mutex
-            mutex.unlock();
-        }
-    }
+// Get the name of a client
+QString Server::clientName(ClientConnection *client) {
+    return roster.name(client);
 }
 
-void Server::newConnection() {
-    while(server->hasPendingConnections())
+// Remove a client from the roster and return its name
+QString Server::removeClient(ClientConnection *client) {
+    bool schedulePublish;
+    QString clientName = roster.leave(client, &schedulePublish);
+    if(schedulePublish)
     {
-        QTcpSocket *client = server->nextPendingConnection();
-        addNewClients(client);
+        QMetaObject::invokeMethod(this, &Server::scheduleRosterPublish, Qt::QueuedConnection);
     }
+    return clientName;
 }
 
-// When a client disconnects
-void Server::clientDisconnected() {
-    QTcpSocket *client = reinterpret_cast<QTcpSocket *>(sender());
-
-    // Remove the client from the list of clients
-    clients.removeAll(client);
-
-    // Send a disconnection message to all remaining clients
-    QString clientName = clientNames[client];
-    Header header(MessageType::Disconnection, clientName.size(), 1, 1);
-    Packet packet(header, clientName);
-
-    sendPacketToAllClients(packet);
-
-    // Remove the client from the list of client names
-    clientNames.remove(client);
-
-    qDebug() << "Client disconnected at port " << client->peerPort() << " with address " << client->peerAddress().toString();
+// Send a packet to all clients, each worker sends it to the clients on its own thread
+// The packet is encoded once by the caller, every recipient gets the same bytes
+void Server::sendPacketToAllClients(const EncodedPacket &packet) {
+    foreach (Worker *worker, workers) {
+        QMetaObject::invokeMethod(worker, [worker, encodedPacket = packet]() mutable {
+            worker->sendPacketToAll(encodedPacket, nullptr);
+        }, Qt::QueuedConnection);
+    }
 }
 
-// Read data from the client
-void Server::readDataFromClient() {
-    QTcpSocket *client = reinterpret_cast<QTcpSocket *>(sender());
+// Send a packet to all clients except the one that sent the packet
+void Server::sendPacketToAllOtherClients(ClientConnection *currentClient, const EncodedPacket &packet) {
+    foreach (Worker *worker, workers) {
+        QMetaObject::invokeMethod(worker, [worker, currentClient, encodedPacket = packet]() mutable {
+            worker->sendPacketToAll(encodedPacket, currentClient);
+        }, Qt::QueuedConnection);
+    }
+}
 
-    QByteArray DataBuffer;
+// Keep the hash of a file once its upload is complete, downloads of part of the file send it along
+void Server::setFileHash(const QString &fileName, const QByteArray &fileHash) {
+    QWriteLocker locker(&fileHashLock);
+    fileHashes.insert(fileName, fileHash);
+}
 
-    QDataStream stream(client);
-    stream.setVersion(QDataStream::Qt_6_7);
+// Get the hash of an uploaded file, empty for files the server has not received itself
+QByteArray Server::fileHash(const QString &fileName) {
+    QReadLocker locker(&fileHashLock);
+    return fileHashes.value(fileName);
+}
 
-    // Read the data from the socket until there is no more data to read
-    while(client->bytesAvailable() >= HEADER_SIZE + DATA_SIZE + TAIL_SIZE)
-    {
-        // Read the data from the socket until the start byte is found
-        while(client->read(1)[0] != START_BYTE)
+// Assign a new connection to the worker with the fewest clients
+// The connections accepted in one go are handed over together once the listener is done accepting
+void Server::newConnection(qintptr socketDescriptor) {
+    Worker *leastLoadedWorker = workers.first();
+    foreach (Worker *worker, workers) {
+        if(worker->load() < leastLoadedWorker->load())
         {
+            leastLoadedWorker = worker;
         }
+    }
 
-        // Read the data from the socket and prepend the start byte
-        DataBuffer = client->read(HEADER_SIZE + DATA_SIZE + TAIL_SIZE - 1);
-        DataBuffer.prepend(START_BYTE);
-
-        // Parse the data buffer and handle the data
-        Packet packet(DataBuffer);
-        Header header = packet.header;
-        QByteArray data = packet.data;
-
-        switch (header.type){
-            case MessageType::Text:
-            {
-                // Forward the message to all other clients
-                sendPacketToAllOtherClients(client, packet);
-                break;
-            }
-            case MessageType::Connection:
-            {
-                // Forward the connection message to all other clients
-                sendPacketToAllOtherClients(client, packet);
-
-                // Add the client to the list of clients
-                clientNames[client] = data.split('\n')[0];
-
-                // Send the list of current clients to the new client
-                QString clientList;
-                foreach(QString clientName, clientNames.values())
-                {
-                    clientList.append(clientName + '\n');
-                }
-                Header feedbackHeader(MessageType::Connection, clientList.size(), 1, 1);
-                Packet feedbackPacket(feedbackHeader, clientList);
-                stream << feedbackPacket.toByteArray();
-
-                break;
-            }
-            case MessageType::Disconnection:
-            {
-                // Handle the disconnection
-                clientDisconnected();
-                break;
-            }
-            case MessageType::FileData:
-            {
-                QFile file(FILE_DIR + header.fileName);
-
-                // Append data to file
-                if(file.open(QIODevice::Append))
-                {
-                    for(int i = 0; i < header.dataSize; i++)
-                    {
-                        file.putChar(data[i]);
-                    }
-                    file.close();
-                }
-
-                // Send file info to all clients if all packets have been received
-                if(header.no == header.totalPacket)
-                {
-                    QString senderName = clientNames[client];
-                    Header fileInfoHeader(MessageType::FileInfo, header.fileName, senderName.size(), 1, 1);
-                    Packet fileInfoPacket(fileInfoHeader, senderName);
-
-                    sendPacketToAllClients(fileInfoPacket);
-                }
-
-                break;
-            }
-            case MessageType::FileInfo:
-            {
-                // Add the client to the file request queue
-                fileRequestQueue.push(client);
+    if(acceptedDescriptors.isEmpty())
+    {
+        QMetaObject::invokeMethod(this, &Server::handOverConnections, Qt::QueuedConnection);
+    }
 
-                readFile(header.fileName);
-                break;
-            }
-            default:
-            {
-                qDebug() << "Unknown message type";
-                break;
+    leastLoadedWorker->reserve();
+    acceptedDescriptors[leastLoadedWorker].append(socketDescriptor);
+}
+
+// Hand the accepted connections to their workers, one call per worker
+void Server::handOverConnections() {
+    for(auto it = acceptedDescriptors.cbegin(); it != acceptedDescriptors.cend(); ++it)
+    {
+        Worker *worker = it.key();
+        QList<qintptr> socketDescriptors = it.value();
+        QMetaObject::invokeMethod(worker, [worker, socketDescriptors]() {
+            foreach (qintptr socketDescriptor, socketDescriptors) {
+                worker->addConnection(socketDescriptor);
             }
-        }
+        }, Qt::QueuedConnection);
     }
+    acceptedDescriptors.clear();
 }
 
-// Send a file to the server
-void Server::sendFileDataPacket()
-{
-    QTcpSocket *client = fileRequestQueue.front();
-    if(client && client->isOpen())
+// Start the batch interval of the roster unless it is already running
+void Server::scheduleRosterPublish() {
+    if(!rosterTimer->isActive())
     {
-        if(currentFileDataPacketIndex != endFileDataPacketIndex)
-        {
-            // Lock the mutex
-            mutex.lock();
+        rosterTimer->start();
+    }
+}
 
-            // Get the paclet
-            Packet packet = fileDataPackets[currentFileDataPacketIndex];
+// Publish the joins and leaves collected during the batch interval and send them to the logged in clients
+void Server::publishRoster() {
+    Roster::Update update = roster.publish();
+    if(update.packets.isEmpty())
+    {
+        return;
+    }
 
-            // Send the packet to the server using the socket
-            QDataStream stream(client);
-            stream.setVersion(QDataStream::Qt_6_7);
+    foreach (Worker *worker, workers) {
+        QMetaObject::invokeMethod(worker, [worker, update]() {
+            worker->sendRosterUpdate(update);
+        }, Qt::QueuedConnection);
+    }
+}
 
-            // Increment the current file data packet index
-            stream << packet.toByteArray();
-            currentFileDataPacketIndex = (currentFileDataPacketIndex + 1) % PACKET_BUFFER_SIZE;
+// Let every worker log the outbound queues of its clients and log the resident memory of the server
+// Builds counting allocations also log how many were made per packet received since the last stats
+void Server::logStats() {
+    qint64 packetCount = 0;
+    foreach (Worker *worker, workers) {
+        packetCount += worker->packetCount();
+        QMetaObject::invokeMethod(worker, &Worker::logStats, Qt::QueuedConnection);
+    }
 
-            // If the last packet was sent, remove the first-in-line client from the queue
-            if(packet.header.no == packet.header.totalPacket)
-            {
-                fileRequestQueue.pop();
-            }
+    qint64 memory = residentMemory();
+    if(memory >= 0)
+    {
+        qDebug() << "Resident memory:" << memory << "bytes";
+    }
 
-            // Unlock the mutex
-            mutex.unlock();
-        }
+    qint64 allocationCount = AllocationCounter::count();
+    if(allocationCount >= 0)
+    {
+        qint64 numAllocations = allocationCount - lastAllocationCount;
+        qint64 numPackets = packetCount - lastPacketCount;
+        qDebug() << numAllocations << "allocations for" << numPackets << "packets received,"
+                 << (numPackets > 0 ? double(numAllocations) / numPackets : 0.0) << "per packet";
     }
+
+    lastAllocationCount = allocationCount;
+    lastPacketCount = packetCount;
 }
@@ -1,47 +1,120 @@
 #ifndef SERVER_H
 #define SERVER_H
 
-#include <QtCore>
-#include <QtNetwork>
-#include <QtWidgets>
-#include <QDir>
-#include <queue>
+#include <QObject>
+#include <QTcpServer>
+#include <QHostAddress>
+#include <QThread>
+#include <QTimer>
+#include <QList>
+#include <QHash>
+#include <QReadWriteLock>
 
 #include "packet.h"
+#include "frame.h"
+#include "transfer_session.h"
+#include "file_writer.h"
+#include "roster.h"
+#include "buffer_pool.h"
 
 #define FILE_DIR "files/"
-#define PACKET_BUFFER_SIZE 50000
+
+// Port the server listens on unless another one is given
+#define DEFAULT_PORT 1234
+
+// Connections waiting to be accepted by a listening socket
+#define LISTEN_BACKLOG 4096
+
+// Default number of bytes of file data queued in a client's write buffer
+#define DEFAULT_WRITE_BUFFER_LIMIT (256 * 1024)
+
+// Default number of bytes of messages queued for a client before its text messages are dropped
+#define DEFAULT_OUTBOUND_QUEUE_LIMIT (1024 * 1024)
+
+// Default time in milliseconds a client may keep dropping messages before it is disconnected
+#define DEFAULT_LAGGARD_TIMEOUT 30000
+
+// Settings of the server, they do not change once it has started
+struct ServerConfig
+{
+    int numWorkers = QThread::idealThreadCount();
+    qint64 writeBufferLimit = DEFAULT_WRITE_BUFFER_LIMIT;
+    qint64 readWindowSize = DEFAULT_READ_WINDOW_SIZE;
+    qint64 fileBufferSize = DEFAULT_FILE_BUFFER_SIZE;
+    qint64 syncInterval = 0;
+    qint64 bufferPoolBudget = DEFAULT_BUFFER_POOL_BUDGET;
+    qint64 outboundQueueLimit = DEFAULT_OUTBOUND_QUEUE_LIMIT;
+    qint64 laggardTimeout = DEFAULT_LAGGARD_TIMEOUT;
+    int statsInterval = 0;
+    QHostAddress listenAddress = QHostAddress(QHostAddress::LocalHost);
+    quint16 port = DEFAULT_PORT;
+    bool reusePort = false;
+};
+
+class Worker;
+class ClientConnection;
+
+// TCP server that hands accepted socket descriptors over instead of creating the sockets itself
+class Listener : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit Listener(QObject *parent = nullptr) : QTcpServer(parent) {}
+    static qintptr openReusePortSocket(const QHostAddress &address, quint16 port);
+
+signals:
+    void newDescriptor(qintptr socketDescriptor);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        emit newDescriptor(socketDescriptor);
+    }
+};
 
 class Server : public QObject
 {
     Q_OBJECT
 
-private:
-    void addNewClients(QTcpSocket *client);
-    void readFile(QString fileName);
-    void sendPacketToAllClients(Packet packet);
-    void sendPacketToAllOtherClients(QTcpSocket *currentClient, Packet packet);
+public:
+    // These functions are called from the worker threads
+    const ServerConfig &config() const;
+    QList<EncodedPacket> joinRoster(ClientConnection *client, QString clientName, bool paged, quint64 *rosterVersion);
+    Packet rosterPage(const QString &cursor);
+    QString clientName(ClientConnection *client);
+    QString removeClient(ClientConnection *client);
+    void sendPacketToAllClients(const EncodedPacket &packet);
+    void sendPacketToAllOtherClients(ClientConnection *currentClient, const EncodedPacket &packet);
+    void setFileHash(const QString &fileName, const QByteArray &fileHash);
+    QByteArray fileHash(const QString &fileName);
 
 private slots:
-    void newConnection();
-    void clientDisconnected();
-    void readDataFromClient();
-    void sendFileDataPacket();
+    void newConnection(qintptr socketDescriptor);
+    void handOverConnections();
+    void scheduleRosterPublish();
+    void publishRoster();
+    void logStats();
 
 public:
-    Server();
+    Server(ServerConfig config);
     ~Server();
 
 private:
-    QTcpServer *server;
-    QList<QTcpSocket *> clients;
-    QMap<QTcpSocket*, QString> clientNames;
-    QTimer *timer;
-    Packet *fileDataPackets;
-    std::queue<QTcpSocket*> fileRequestQueue;
-    QMutex mutex;
-    int endFileDataPacketIndex;
-    int currentFileDataPacketIndex;
+    bool startReusePortListeners();
+
+    Listener *server;
+    QList<QThread *> workerThreads;
+    QList<Worker *> workers;
+    ServerConfig serverConfig;
+    QTimer *statsTimer;
+    qint64 lastAllocationCount;
+    qint64 lastPacketCount;
+    QTimer *rosterTimer;
+    Roster roster;
+    QHash<Worker *, QList<qintptr>> acceptedDescriptors;
+    QReadWriteLock fileHashLock;
+    QHash<QString, QByteArray> fileHashes;
 };
 
 #endif // SERVER_H
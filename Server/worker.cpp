@@ -0,0 +1,155 @@
+#include "worker.h"
+#include "client_connection.h"
+#include "server.h"
+
+#include <QDebug>
+#include <QThread>
+
+// The buffer budget of the server is shared evenly between the workers
+Worker::Worker(Server *server)
+    : pool(server->config().bufferPoolBudget / server->config().numWorkers)
+{
+    this->server = server;
+    this->numConnections.storeRelaxed(0);
+    this->numPackets.storeRelaxed(0);
+}
+
+Worker::~Worker()
+{
+    qDeleteAll(connections);
+}
+
+// Number of clients assigned to this worker, read by the thread accepting connections
+// Download streams are left out once they ask for their range, they only receive file data
+int Worker::load() const
+{
+    return numConnections.loadRelaxed();
+}
+
+// Number of packets received by this worker's clients, read by the thread logging the stats
+qint64 Worker::packetCount() const
+{
+    return numPackets.loadRelaxed();
+}
+
+// Count packets received by a client, only called on this worker's thread
+void Worker::countPackets(qint64 numPackets)
+{
+    this->numPackets.storeRelaxed(this->numPackets.loadRelaxed() + numPackets);
+}
+
+// Pool of the file transfer buffers of this worker's clients
+BufferPool *Worker::bufferPool()
+{
+    return &pool;
+}
+
+// Count a connection that is about to be handed to this worker
+void Worker::reserve()
+{
+    numConnections.ref();
+}
+
+// Stop counting a connection that turned out to be a download stream, it does not count towards the load of the worker
+void Worker::countDownloadStream()
+{
+    numConnections.deref();
+}
+
+// Accept connections on a listening socket of this worker, they are handled on this thread
+void Worker::listen(qintptr listenSocketDescriptor)
+{
+    Listener *listener = new Listener(this);
+    if(!listener->setSocketDescriptor(listenSocketDescriptor))
+    {
+        qDebug() << "Worker" << QThread::currentThread() << "could not listen:" << listener->errorString();
+        delete listener;
+        return;
+    }
+
+    connect(listener, &Listener::newDescriptor, this, [this](qintptr socketDescriptor) {
+        reserve();
+        addConnection(socketDescriptor);
+    });
+}
+
+// Create the socket of a newly accepted connection on this thread
+void Worker::addConnection(qintptr socketDescriptor)
+{
+    ClientConnection *connection = new ClientConnection(server, this);
+    if(!connection->open(socketDescriptor))
+    {
+        numConnections.deref();
+        delete connection;
+        return;
+    }
+
+    connections.append(connection);
+}
+
+// Forget a client once it has disconnected
+void Worker::removeConnection(ClientConnection *connection)
+{
+    if(connections.removeAll(connection) > 0)
+    {
+        if(!connection->isDownloadStream())
+        {
+            numConnections.deref();
+        }
+        connection->deleteLater();
+    }
+}
+
+// Send a packet to every logged in client of this worker except one
+void Worker::sendPacketToAll(EncodedPacket &packet, ClientConnection *except)
+{
+    foreach (ClientConnection *connection, connections) {
+        if(connection != except && connection->isLoggedIn())
+        {
+            connection->sendFrame(packet.frame(connection->headerFormat()), packet.type() == MessageType::Text);
+        }
+    }
+}
+
+// Send the changes of the roster to the clients of this worker, they share the encoded packets
+void Worker::sendRosterUpdate(Roster::Update update)
+{
+    foreach (ClientConnection *connection, connections) {
+        if(connection->headerFormat() == HeaderFormat::Text)
+        {
+            connection->sendRosterUpdate(update.textPackets, update.version);
+        }
+        else
+        {
+            connection->sendRosterUpdate(update.packets, update.version);
+        }
+    }
+}
+
+// Log the outbound queue depth and drop counters of this worker's clients
+void Worker::logStats()
+{
+    qint64 queuedBytes = 0;
+    qint64 droppedMessages = 0;
+    qint64 droppedBytes = 0;
+    int numLagging = 0;
+    int numStreams = 0;
+
+    foreach (ClientConnection *connection, connections) {
+        if(connection->isDownloadStream())
+        {
+            numStreams++;
+        }
+        queuedBytes += connection->queuedBytes();
+        droppedMessages += connection->droppedMessages();
+        droppedBytes += connection->droppedBytes();
+        if(connection->queuedBytes() > 0)
+        {
+            numLagging++;
+        }
+    }
+
+    qDebug() << "Worker" << QThread::currentThread() << ":" << connections.size() - numStreams << "clients," << numStreams << "download streams," << numLagging << "with queued data,"
+             << queuedBytes << "bytes queued," << droppedMessages << "messages dropped," << droppedBytes << "bytes dropped,"
+             << pool.usedBytes() << "buffer bytes in use," << pool.freeBytes() << "buffer bytes free";
+}
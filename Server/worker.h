@@ -0,0 +1,46 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <QObject>
+#include <QList>
+#include <QAtomicInt>
+
+#include "packet.h"
+#include "frame.h"
+#include "roster.h"
+#include "buffer_pool.h"
+
+class Server;
+class ClientConnection;
+
+// Event loop thread owning a share of the client sockets
+// Its functions are only called on its own thread, other threads reach it with queued calls
+class Worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    Worker(Server *server);
+    ~Worker();
+    int load() const;
+    qint64 packetCount() const;
+    void countPackets(qint64 numPackets);
+    BufferPool *bufferPool();
+    void reserve();
+    void countDownloadStream();
+    void listen(qintptr listenSocketDescriptor);
+    void addConnection(qintptr socketDescriptor);
+    void removeConnection(ClientConnection *connection);
+    void sendPacketToAll(EncodedPacket &packet, ClientConnection *except);
+    void sendRosterUpdate(Roster::Update update);
+    void logStats();
+
+private:
+    Server *server;
+    QList<ClientConnection *> connections;
+    QAtomicInt numConnections;
+    QAtomicInteger<qint64> numPackets;
+    BufferPool pool;
+};
+
+#endif // WORKER_H